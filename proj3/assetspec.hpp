@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#include "fixedpoint.hpp"
+
+// Listing terms of one asset. Amounts and prices are raw fixed-point units
+// (see fixedpoint.hpp); prices are per whole unit of the asset, in `quote`.
+struct AssetSpec {
+  std::string symbol;
+  std::string quote = "USD";
+  int qty_decimals = 0; // amounts are in units of 10^-qty_decimals
+  Qty lot_size = 1;     // amounts must be multiples of this
+  Price tick_size = 1;  // prices must be multiples of this
+  Price min_price = 0;  // lowest accepted price
+  Price max_price = 0;  // highest accepted price; 0 leaves the band open
+
+  bool HasBand() const { return max_price > 0; }
+
+  // Ticks from min_price to max_price inclusive. Needs a band.
+  std::size_t BandLevels() const {
+    return (max_price - min_price).Raw() / tick_size.Raw() + 1;
+  }
+
+  // Whether an order for `amount` at `price` is a whole number of lots at a
+  // tick inside the band.
+  bool Accepts(Qty amount, Price price) const {
+    return amount > 0 && price > 0 && amount.Raw() % lot_size.Raw() == 0 &&
+           price.Raw() % tick_size.Raw() == 0 && price >= min_price &&
+           (!HasBand() || price <= max_price);
+  }
+};
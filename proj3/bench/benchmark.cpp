@@ -0,0 +1,127 @@
+#include "benchmark.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+std::atomic<std::uint64_t> allocation_count{0};
+
+void *CountedAlloc(std::size_t size, std::size_t alignment) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  void *p = (alignment > alignof(std::max_align_t))
+                ? std::aligned_alloc(alignment, (size + alignment - 1) /
+                                                    alignment * alignment)
+                : std::malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+} // namespace
+
+// Every allocation in the benchmark binaries goes through these, so the
+// harness can report allocations per operation.
+void *operator new(std::size_t size) { return CountedAlloc(size, 0); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return CountedAlloc(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+namespace bench {
+
+std::uint64_t AllocationCount() {
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+void State::PauseTiming() {
+  if (!timing) return;
+  elapsed += Clock::now() - start;
+  allocations += AllocationCount() - allocs_at_start;
+  timing = false;
+}
+
+void State::ResumeTiming() {
+  if (timing) return;
+  allocs_at_start = AllocationCount();
+  start = Clock::now();
+  timing = true;
+}
+
+namespace {
+std::vector<Benchmark *> &Registry() {
+  static std::vector<Benchmark *> registry;
+  return registry;
+}
+
+std::string RunName(const Benchmark &b, const std::vector<std::int64_t> &args) {
+  std::string name = b.name;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    name += '/';
+    if (i < b.arg_names.size()) name += b.arg_names[i] + ':';
+    name += std::to_string(args[i]);
+  }
+  return name;
+}
+
+void Run(const Benchmark &b, const std::vector<std::int64_t> &args,
+         double min_time) {
+  std::int64_t iterations = 1;
+  for (;;) {
+    State state(iterations, args);
+    b.fn(state);
+    const double seconds = state.Seconds();
+    if (seconds >= min_time || iterations >= 1000000000) {
+      std::printf("%-56s %12.1f %12lld %12.2f\n", RunName(b, args).c_str(),
+                  seconds * 1e9 / iterations,
+                  static_cast<long long>(iterations),
+                  static_cast<double>(state.Allocations()) / iterations);
+      std::fflush(stdout);
+      return;
+    }
+    // Aim a little past min_time, growing at most 100x per attempt.
+    const double scale = min_time * 1.4 / std::max(seconds, 1e-9);
+    iterations = std::max<std::int64_t>(
+        iterations + 1, static_cast<std::int64_t>(
+                            iterations * std::min(scale, 100.0)));
+  }
+}
+} // namespace
+
+Benchmark *Register(const char *name, Benchmark::Function fn) {
+  Registry().push_back(new Benchmark(name, fn));
+  return Registry().back();
+}
+
+int RunAll(int argc, char *argv[]) {
+  std::string filter;
+  double min_time = 0.5;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strncmp(argv[i], "--filter=", 9)) filter = argv[i] + 9;
+    else if (!std::strncmp(argv[i], "--min_time=", 11)) {
+      min_time = std::atof(argv[i] + 11);
+    } else {
+      std::fprintf(stderr, "usage: %s [--filter=substr] [--min_time=sec]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+  std::printf("%-56s %12s %12s %12s\n", "Benchmark", "ns/op", "Iterations",
+              "Allocs/op");
+  std::printf("%s\n", std::string(95, '-').c_str());
+  for (const Benchmark *b : Registry()) {
+    if (b->name.find(filter) == std::string::npos) continue;
+    if (b->arg_sets.empty()) Run(*b, {}, min_time);
+    for (const auto &args : b->arg_sets) Run(*b, args, min_time);
+  }
+  return 0;
+}
+
+} // namespace bench
@@ -0,0 +1,97 @@
+#pragma once
+// A small harness modelled on Google Benchmark. A benchmark is a function
+// taking a State; it does its setup, then loops on KeepRunning() around the
+// code being measured. The runner grows the iteration count until a run lasts
+// at least --min_time seconds and reports ns/op and global allocations/op
+// (operator new calls made while timing is on).
+//
+//   void BM_Thing(bench::State &state) {
+//     Setup(state.range(0));
+//     while (state.KeepRunning()) DoThing();
+//   }
+//   BENCHMARK(BM_Thing)->Args({1000})->Args({100000});
+//   BENCHMARK_MAIN();
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Number of operator new calls since program start.
+std::uint64_t AllocationCount();
+
+class State {
+public:
+  State(std::int64_t iterations, std::vector<std::int64_t> args)
+      : args(std::move(args)), remaining(iterations), iterations(iterations) {}
+
+  bool KeepRunning() {
+    if (remaining-- > 0) {
+      if (!started) ResumeTiming(), started = true;
+      return true;
+    }
+    PauseTiming();
+    return false;
+  }
+
+  // Excludes per-iteration setup or cleanup from the measurement.
+  void PauseTiming();
+  void ResumeTiming();
+
+  std::int64_t range(std::size_t i) const { return args.at(i); }
+  std::int64_t Iterations() const { return iterations; }
+  double Seconds() const { return std::chrono::duration<double>(elapsed).count(); }
+  std::uint64_t Allocations() const { return allocations; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  std::vector<std::int64_t> args;
+  std::int64_t remaining;
+  std::int64_t iterations;
+  bool started = false;
+  bool timing = false;
+  Clock::time_point start = {};
+  Clock::duration elapsed = {};
+  std::uint64_t allocs_at_start = 0;
+  std::uint64_t allocations = 0;
+};
+
+class Benchmark {
+public:
+  using Function = void (*)(State &);
+
+  Benchmark(std::string name, Function fn) : name(std::move(name)), fn(fn) {}
+
+  // Adds one argument set; the benchmark runs once per set.
+  Benchmark *Args(std::vector<std::int64_t> set) {
+    arg_sets.push_back(std::move(set));
+    return this;
+  }
+  // Names shown for each argument in the report, e.g. "depth".
+  Benchmark *ArgNames(std::vector<std::string> names) {
+    arg_names = std::move(names);
+    return this;
+  }
+
+  std::string name;
+  Function fn;
+  std::vector<std::vector<std::int64_t>> arg_sets;
+  std::vector<std::string> arg_names;
+};
+
+Benchmark *Register(const char *name, Benchmark::Function fn);
+
+// Runs every registered benchmark whose name contains --filter=<substring>.
+int RunAll(int argc, char *argv[]);
+
+} // namespace bench
+
+#define BENCHMARK_CONCAT2(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT2(a, b)
+#define BENCHMARK(fn)                                                          \
+  static ::bench::Benchmark *BENCHMARK_CONCAT(bench_registration_, __LINE__) = \
+      ::bench::Register(#fn, fn)
+#define BENCHMARK_MAIN()                                                       \
+  int main(int argc, char *argv[]) { return ::bench::RunAll(argc, argv); }
@@ -0,0 +1,83 @@
+// Measures what the outbound event stream costs the matching thread. A
+// generated workload is run through an Exchange with no event ring, then
+// with a ring followed by one and two reader threads, each with the fill
+// history kept and dropped. Readers only count what they read, so the
+// numbers show the publishing overhead and any back-pressure from readers
+// that fall a full ring behind.
+//
+// Usage: events-bench [orders=200000] [capacity=65536]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "events.hpp"
+#include "exchange.hpp"
+#include "workload.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Runs the workload with `reader_count` threads following the ring (none
+// attached when zero) and prints one result row.
+void Measure(const WorkloadNames &names,
+             const std::vector<WorkloadRecord> &records, std::size_t capacity,
+             std::size_t reader_count, bool keep_history) {
+  EventRing ring(capacity, WaitStrategy::Futex);
+  Exchange e;
+  e.keep_history = keep_history;
+  if (reader_count) e.events = &ring;
+
+  std::vector<std::size_t> cursors;
+  for (std::size_t i = 0; i < reader_count; ++i) {
+    cursors.push_back(ring.AddReader());
+  }
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  for (std::size_t cursor : cursors) {
+    readers.emplace_back([&ring, &done, cursor] {
+      ExecutionEvent event;
+      for (;;) {
+        if (ring.TryRead(cursor, event)) continue;
+        if (done.load(std::memory_order_acquire)) {
+          while (ring.TryRead(cursor, event)) {
+          }
+          return;
+        }
+        std::this_thread::yield();
+      }
+    });
+  }
+
+  const auto start = Clock::now();
+  ApplyWorkload(e, names, records);
+  const double seconds = SecondsSince(start);
+  done.store(true, std::memory_order_release);
+  for (std::thread &t : readers) t.join();
+
+  std::printf("%-8zu %-8s %12.0f %12llu\n", reader_count,
+              keep_history ? "kept" : "dropped", records.size() / seconds,
+              static_cast<unsigned long long>(ring.Published()));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  WorkloadConfig config;
+  config.orders = (argc > 1) ? std::atoll(argv[1]) : 200000;
+  config.users = 1000;
+  const std::size_t capacity = (argc > 2) ? std::atoll(argv[2]) : 65536;
+  const std::vector<WorkloadRecord> records = GenerateWorkload(config);
+  const WorkloadNames names(config.users, config.assets);
+
+  std::printf("%-8s %-8s %12s %12s\n", "Readers", "History", "commands/s",
+              "events");
+  for (std::size_t readers : {0, 1, 2}) {
+    for (bool keep_history : {true, false}) {
+      Measure(names, records, capacity, readers, keep_history);
+    }
+  }
+}
@@ -0,0 +1,226 @@
+// Microbenchmarks for the Exchange public API. Run `exchange-bench --help`
+// for flags; see benchmark.hpp for how runs are timed.
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "exchange.hpp"
+
+namespace {
+
+constexpr int kOrdersPerLevel = 4;
+constexpr int kAskBase = 10000;
+constexpr int kBidBase = 9000;
+
+// An exchange with `users` funded accounts and `depth` single-unit asks for
+// BTC, kOrdersPerLevel per level on consecutive prices from kAskBase up.
+// Makers and takers are picked round-robin from the same users so balances
+// stay bounded however long a benchmark runs. With `ladder`, BTC is listed
+// with a price band so its book uses ladder levels.
+struct Market {
+  Market(std::int64_t user_count, std::int64_t depth, bool ladder = false) {
+    if (ladder) {
+      AssetSpec btc{"BTC"};
+      btc.min_price = 1;
+      btc.max_price = 1 << 17;
+      e.ListAsset(btc);
+    }
+    for (std::int64_t i = 0; i < user_count; ++i) {
+      users.push_back("user" + std::to_string(i));
+      e.MakeDeposit(users.back(), "USD", 100000000);
+      e.MakeDeposit(users.back(), "BTC", 100000000);
+    }
+    for (int level = 0; level < depth / kOrdersPerLevel; ++level) {
+      AddLevel(kAskBase + level);
+    }
+  }
+
+  const std::string &NextUser() { return users[next_user++ % users.size()]; }
+
+  void AddLevel(int price) {
+    for (int i = 0; i < kOrdersPerLevel; ++i) {
+      e.AddOrder({NextUser(), "Sell", "BTC", 1, price});
+    }
+  }
+
+  Exchange e;
+  std::vector<std::string> users;
+  std::size_t next_user = 0;
+};
+
+// Args: depth, users, ladder. A buy below the best ask that rests on the
+// book.
+void BM_AddNonCrossing(bench::State &state) {
+  Market m(state.range(1), state.range(0), state.range(2));
+  std::vector<OrderId> resting;
+  int i = 0;
+  while (state.KeepRunning()) {
+    resting.push_back(
+        m.e.AddOrder({m.NextUser(), "Buy", "BTC", 1, kBidBase - i++ % 100}));
+    if (resting.size() == 1024) {
+      state.PauseTiming();
+      for (OrderId id : resting) m.e.CancelOrder(id);
+      resting.clear();
+      state.ResumeTiming();
+    }
+  }
+}
+BENCHMARK(BM_AddNonCrossing)
+    ->ArgNames({"depth", "users", "ladder"})
+    ->Args({1000, 10, 0})
+    ->Args({100000, 10, 0})
+    ->Args({100000, 10000, 0})
+    ->Args({100000, 10, 1});
+
+// Args: depth, users, ladder. A buy that exactly fills the best ask level.
+void BM_AddCrossingOneLevel(bench::State &state) {
+  Market m(state.range(1), state.range(0), state.range(2));
+  while (state.KeepRunning()) {
+    m.e.AddOrder({m.NextUser(), "Buy", "BTC", kOrdersPerLevel, kAskBase});
+    state.PauseTiming();
+    m.AddLevel(kAskBase);
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_AddCrossingOneLevel)
+    ->ArgNames({"depth", "users", "ladder"})
+    ->Args({1000, 10, 0})
+    ->Args({100000, 10, 0})
+    ->Args({100000, 10000, 0})
+    ->Args({100000, 10, 1});
+
+// Args: gap, ladder. A buy that takes the only ask at the best price, leaving
+// the next ask `gap` ticks away as the new best.
+void BM_RecoverBestAcrossGap(bench::State &state) {
+  const int gap = state.range(0);
+  Market m(10, 0, state.range(1));
+  m.AddLevel(kAskBase + gap);
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    m.e.AddOrder({m.NextUser(), "Sell", "BTC", 1, kAskBase});
+    state.ResumeTiming();
+    m.e.AddOrder({m.NextUser(), "Buy", "BTC", 1, kAskBase});
+  }
+}
+BENCHMARK(BM_RecoverBestAcrossGap)
+    ->ArgNames({"gap", "ladder"})
+    ->Args({1, 0})
+    ->Args({100000, 0})
+    ->Args({1, 1})
+    ->Args({100, 1})
+    ->Args({100000, 1});
+
+// Args: levels swept, depth, users. A buy that takes the best `levels` levels.
+void BM_SweepLevels(bench::State &state) {
+  const int levels = state.range(0);
+  Market m(state.range(2), state.range(1));
+  while (state.KeepRunning()) {
+    m.e.AddOrder({m.NextUser(), "Buy", "BTC", kOrdersPerLevel * levels,
+                  kAskBase + levels - 1});
+    state.PauseTiming();
+    for (int level = 0; level < levels; ++level) m.AddLevel(kAskBase + level);
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_SweepLevels)
+    ->ArgNames({"levels", "depth", "users"})
+    ->Args({1, 100000, 1000})
+    ->Args({8, 100000, 1000})
+    ->Args({64, 100000, 1000});
+
+// A burst of `size` orders from `users` users: sells resting at kAskBase,
+// then buys that fill them, so the book is back to empty after each burst.
+std::vector<Order> Burst(Market &m, std::int64_t size) {
+  std::vector<Order> burst;
+  for (std::int64_t i = 0; i < size; ++i) {
+    burst.push_back({m.NextUser(), (i < size / 2) ? "Sell" : "Buy", "BTC", 1,
+                     kAskBase});
+  }
+  return burst;
+}
+
+// Args: burst size, users. One AddOrder call per order of a burst.
+void BM_AddOrderLoop(bench::State &state) {
+  Market m(state.range(1), 0);
+  const std::vector<Order> burst = Burst(m, state.range(0));
+  while (state.KeepRunning()) {
+    for (const Order &order : burst) m.e.AddOrder(order);
+  }
+}
+BENCHMARK(BM_AddOrderLoop)
+    ->ArgNames({"burst", "users"})
+    ->Args({16, 4})
+    ->Args({256, 4})
+    ->Args({256, 1000});
+
+// Args: burst size, users. The same burst through one AddOrders call.
+void BM_AddOrdersBatch(bench::State &state) {
+  Market m(state.range(1), 0);
+  const std::vector<Order> burst = Burst(m, state.range(0));
+  while (state.KeepRunning()) m.e.AddOrders(burst);
+}
+BENCHMARK(BM_AddOrdersBatch)
+    ->ArgNames({"burst", "users"})
+    ->Args({16, 4})
+    ->Args({256, 4})
+    ->Args({256, 1000});
+
+// Args: users. A deposit followed by a withdrawal of the same amount.
+void BM_DepositWithdraw(bench::State &state) {
+  Market m(state.range(0), 0);
+  while (state.KeepRunning()) {
+    const std::string &user = m.NextUser();
+    m.e.MakeDeposit(user, "USD", 10);
+    m.e.MakeWithdrawal(user, "USD", 10);
+  }
+}
+BENCHMARK(BM_DepositWithdraw)
+    ->ArgNames({"users"})
+    ->Args({10})
+    ->Args({100000});
+
+// Args: assets, depth per side. Prints the spread of `assets` open books.
+void BM_PrintBidAskSpread(bench::State &state) {
+  Market m(10, 0);
+  for (std::int64_t a = 0; a < state.range(0); ++a) {
+    const std::string asset = "ASSET" + std::to_string(a);
+    for (const std::string &user : m.users) m.e.MakeDeposit(user, asset, 1000);
+    for (std::int64_t i = 0; i < state.range(1); ++i) {
+      m.e.AddOrder({m.NextUser(), "Buy", asset, 1, kBidBase - int(i)});
+      m.e.AddOrder({m.NextUser(), "Sell", asset, 1, kAskBase + int(i)});
+    }
+  }
+  std::ostringstream oss;
+  while (state.KeepRunning()) {
+    oss.str("");
+    m.e.PrintBidAskSpread(oss);
+  }
+}
+BENCHMARK(BM_PrintBidAskSpread)
+    ->ArgNames({"assets", "depth"})
+    ->Args({3, 100})
+    ->Args({100, 100});
+
+// Args: users, fills. Prints every user's open and filled orders after
+// `fills` single-unit trades spread round-robin over the users.
+void BM_PrintUsersOrders(bench::State &state) {
+  Market m(state.range(0), 0);
+  for (std::int64_t i = 0; i < state.range(1); ++i) {
+    m.e.AddOrder({m.NextUser(), "Sell", "BTC", 1, kAskBase});
+    m.e.AddOrder({m.NextUser(), "Buy", "BTC", 1, kAskBase});
+  }
+  std::ostringstream oss;
+  while (state.KeepRunning()) {
+    oss.str("");
+    m.e.PrintUsersOrders(oss);
+  }
+}
+BENCHMARK(BM_PrintUsersOrders)
+    ->ArgNames({"users", "fills"})
+    ->Args({100, 10000})
+    ->Args({10000, 10000});
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,69 @@
+// Measures taker fill throughput against a deep book. The book is seeded with
+// `depth` resting single-unit asks spread over 1000 price levels; each round
+// replenishes one ask and sends a buy that fills exactly one maker, so the
+// book stays at `depth` orders. Only the taker AddOrder calls are timed.
+// The fill record arenas are reserved up front, so the loop should make no
+// allocations at all. Two counts check that: the engine's counters, which
+// see only its pool and arenas, and every global operator new call the loop
+// made, wherever in the engine it came from (order index, per-user lists,
+// vectors, strings).
+//
+// Usage: fills-bench [depth=100000] [fills=100000] [max_seconds=10]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "exchange.hpp"
+
+int main(int argc, char *argv[]) {
+  const int depth = (argc > 1) ? std::atoi(argv[1]) : 100000;
+  const int fills = (argc > 2) ? std::atoi(argv[2]) : 100000;
+  const double max_seconds = (argc > 3) ? std::atof(argv[3]) : 10.0;
+  const int kMakers = 1000, kLevels = 1000, kLowPrice = 1000;
+
+  Exchange e;
+  std::vector<std::string> makers;
+  for (int i = 0; i < kMakers; ++i) {
+    makers.push_back("maker" + std::to_string(i));
+    e.MakeDeposit(makers.back(), "BTC", 1000000);
+  }
+  e.MakeDeposit("taker", "USD", 2000000000);
+  for (int i = 0; i < depth; ++i) {
+    e.AddOrder({makers[i % kMakers], "Sell", "BTC", 1, kLowPrice + i % kLevels});
+  }
+
+  e.filled_orders.Reserve(2 * fills);
+  e.trade_history.Reserve(fills);
+  const AllocationCounters before = e.GetAllocationCounters();
+  const std::uint64_t news_before = bench::AllocationCount();
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration elapsed{};
+  int done = 0;
+  for (; done < fills; ++done) {
+    if (std::chrono::duration<double>(elapsed).count() > max_seconds) break;
+    e.AddOrder({makers[done % kMakers], "Sell", "BTC", 1,
+                kLowPrice + done % kLevels});
+    const auto start = Clock::now();
+    e.AddOrder({"taker", "Buy", "BTC", 1, kLowPrice + kLevels});
+    elapsed += Clock::now() - start;
+  }
+
+  const std::uint64_t news = bench::AllocationCount() - news_before;
+  const AllocationCounters after = e.GetAllocationCounters();
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << "resting orders: " << depth << '\n'
+            << "fills:          " << done << '\n'
+            << "seconds:        " << seconds << '\n'
+            << "fills/sec:      " << done / seconds << '\n'
+            << "ns/fill:        " << seconds * 1e9 / done << '\n'
+            << "pool blocks:    "
+            << after.pool_allocations - before.pool_allocations << '\n'
+            << "upstream:       "
+            << after.upstream_allocations - before.upstream_allocations << '\n'
+            << "operator new:   " << news << std::endl;
+  return 0;
+}
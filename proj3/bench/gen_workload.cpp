@@ -0,0 +1,53 @@
+// Writes a synthetic workload file for `replay`.
+//
+// Usage: gen-workload <out-file> [--orders=N] [--users=N] [--assets=N]
+//        [--seed=N] [--rate=orders/sec] [--zipf=s] [--cancel_ratio=r]
+//        [--replace_ratio=r] [--mid=price] [--max_amount=N]
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "workload.hpp"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argv[1][0] == '-') {
+    std::cerr << "usage: " << argv[0] << " <out-file> [--orders=N] [--users=N]"
+              << " [--assets=N] [--seed=N] [--rate=R] [--zipf=S]"
+              << " [--cancel_ratio=R] [--replace_ratio=R] [--mid=P]"
+              << " [--max_amount=N]" << std::endl;
+    return 1;
+  }
+  WorkloadConfig config;
+  for (int i = 2; i < argc; ++i) {
+    const char *eq = std::strchr(argv[i], '=');
+    if (!eq) {
+      std::cerr << "bad flag: " << argv[i] << std::endl;
+      return 1;
+    }
+    const std::string flag(argv[i], eq - argv[i]);
+    const char *value = eq + 1;
+    if (flag == "--orders") config.orders = std::strtoull(value, nullptr, 10);
+    else if (flag == "--users") config.users = std::atoi(value);
+    else if (flag == "--assets") config.assets = std::atoi(value);
+    else if (flag == "--seed") config.seed = std::strtoull(value, nullptr, 10);
+    else if (flag == "--rate") config.orders_per_second = std::atof(value);
+    else if (flag == "--zipf") config.zipf_exponent = std::atof(value);
+    else if (flag == "--cancel_ratio") config.cancel_ratio = std::atof(value);
+    else if (flag == "--replace_ratio") config.replace_ratio = std::atof(value);
+    else if (flag == "--mid") config.mid_price = std::atoi(value);
+    else if (flag == "--max_amount") config.max_amount = std::atoi(value);
+    else {
+      std::cerr << "unknown flag: " << flag << std::endl;
+      return 1;
+    }
+  }
+
+  const std::vector<WorkloadRecord> records = GenerateWorkload(config);
+  if (!WriteWorkload(argv[1], config, records)) {
+    std::cerr << "could not write " << argv[1] << std::endl;
+    return 1;
+  }
+  std::cout << "wrote " << records.size() << " records to " << argv[1]
+            << std::endl;
+  return 0;
+}
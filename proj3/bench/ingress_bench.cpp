@@ -0,0 +1,93 @@
+// Measures enqueue-to-ack latency through IngressEngine for each topology
+// and wait strategy. Every gateway thread sends single-unit orders one at a
+// time, alternating a sell with a buy that fills it, and times each from
+// just before Send() until its ack is received. Busy-spin runs are skipped
+// when there are fewer hardware threads than gateways plus the matching
+// thread, since spinning threads would then only wait on each other.
+//
+// Usage: ingress-bench [gateways=2] [messages=100000]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ingress.hpp"
+#include "latency.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void RunGateway(IngressEngine &engine, std::size_t gateway, long messages,
+                LatencyHistogram &latency) {
+  const std::string user = "gateway" + std::to_string(gateway);
+  for (long i = 0; i < messages; ++i) {
+    const IngressMessage message = IngressMessage::AddOrder(
+        i, {user, (i % 2) ? "Buy" : "Sell", "BTC", 1, 1000});
+    const auto start = Clock::now();
+    engine.Send(gateway, message);
+    engine.ReceiveAck(gateway);
+    latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       Clock::now() - start)
+                       .count());
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const std::size_t gateways = (argc > 1) ? std::atoi(argv[1]) : 2;
+  const long messages = (argc > 2) ? std::atol(argv[2]) : 100000;
+  const unsigned cores = std::thread::hardware_concurrency();
+
+  std::printf("%-8s %-6s %12s %8s %8s %8s %10s\n", "Rings", "Wait",
+              "msgs/s", "p50", "p99", "p99.9", "max (ns)");
+  for (IngressTopology topology :
+       {IngressTopology::SpscPerGateway, IngressTopology::SharedMpsc}) {
+    const char *rings =
+        (topology == IngressTopology::SharedMpsc) ? "mpsc" : "spsc";
+    for (WaitStrategy wait :
+         {WaitStrategy::Spin, WaitStrategy::Yield, WaitStrategy::Futex}) {
+      if (wait == WaitStrategy::Spin && cores < gateways + 1) {
+        std::printf("%-8s %-6s skipped: needs %zu hardware threads, have %u\n",
+                    rings, WaitStrategyName(wait), gateways + 1, cores);
+        continue;
+      }
+      Exchange e;
+      for (std::size_t g = 0; g < gateways; ++g) {
+        e.MakeDeposit("gateway" + std::to_string(g), "USD", 1000000000000);
+        e.MakeDeposit("gateway" + std::to_string(g), "BTC", 1000000000);
+      }
+      IngressOptions options;
+      options.gateways = gateways;
+      options.topology = topology;
+      options.wait = wait;
+      IngressEngine engine(e, options);
+      engine.Start();
+
+      std::vector<LatencyHistogram> latencies(gateways);
+      std::vector<std::thread> threads;
+      const auto start = Clock::now();
+      for (std::size_t g = 0; g < gateways; ++g) {
+        threads.emplace_back(RunGateway, std::ref(engine), g, messages,
+                             std::ref(latencies[g]));
+      }
+      for (std::thread &t : threads) t.join();
+      const double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+      engine.Stop();
+
+      LatencyHistogram all;
+      for (const LatencyHistogram &h : latencies) all.Merge(h);
+      std::printf("%-8s %-6s %12.0f %8llu %8llu %8llu %10llu\n", rings,
+                  WaitStrategyName(wait), all.Count() / seconds,
+                  static_cast<unsigned long long>(all.Percentile(0.5)),
+                  static_cast<unsigned long long>(all.Percentile(0.99)),
+                  static_cast<unsigned long long>(all.Percentile(0.999)),
+                  static_cast<unsigned long long>(all.Max()));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+// Measures the level-2 feed. A generated workload is run through an
+// Exchange whose event ring is drained into a MarketDataFeed after every
+// command, once per conflation window, with one subscriber counting what it
+// receives. The rows show the cost of maintaining depth and how far each
+// window cuts the update rate a slow consumer has to keep up with.
+//
+// Usage: marketdata-bench [orders=200000] [snapshot_ms=1000]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "exchange.hpp"
+#include "marketdata.hpp"
+#include "workload.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void Measure(const WorkloadNames &names,
+             const std::vector<WorkloadRecord> &records,
+             Clock::duration snapshot_interval, Clock::duration conflation) {
+  EventRing ring(4096, WaitStrategy::Yield);
+  const std::size_t reader = ring.AddReader();
+  Exchange e;
+  e.events = &ring;
+  e.keep_history = false;
+  MarketDataFeed feed(snapshot_interval);
+  std::size_t updates = 0, snapshots = 0;
+  feed.Subscribe({conflation, [&](const DepthUpdate &) { ++updates; },
+                  [&](const DepthSnapshot &) { ++snapshots; }});
+
+  std::vector<OrderId> ids(records.size(), kInvalidOrderId);
+  const auto start = Clock::now();
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    ApplyWorkloadRecord(e, names, records, i, ids);
+    feed.Pump(ring, reader);
+  }
+  const double seconds = SecondsSince(start);
+
+  std::printf("%-12.3f %12.0f %12llu %12zu %10zu %10.1f\n",
+              std::chrono::duration<double, std::milli>(conflation).count(),
+              records.size() / seconds,
+              static_cast<unsigned long long>(feed.Updates()), updates,
+              snapshots, updates ? double(feed.Updates()) / updates : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  WorkloadConfig config;
+  config.orders = (argc > 1) ? std::atoll(argv[1]) : 200000;
+  config.users = 1000;
+  const std::chrono::milliseconds snapshot_interval(
+      (argc > 2) ? std::atoll(argv[2]) : 1000);
+  const std::vector<WorkloadRecord> records = GenerateWorkload(config);
+  const WorkloadNames names(config.users, config.assets);
+
+  std::printf("%-12s %12s %12s %12s %10s %10s\n", "window(ms)", "commands/s",
+              "changes", "updates", "snapshots", "merged");
+  using std::chrono::microseconds;
+  for (Clock::duration window :
+       {Clock::duration::zero(), Clock::duration(microseconds(100)),
+        Clock::duration(microseconds(1000)),
+        Clock::duration(microseconds(10000))}) {
+    Measure(names, records, snapshot_interval, window);
+  }
+}
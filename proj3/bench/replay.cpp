@@ -0,0 +1,82 @@
+// Feeds a workload file (see gen-workload) into an Exchange as fast as
+// possible, ignoring arrival times, and reports sustained throughput and
+// per-order latency percentiles. Deposits are applied first and not timed.
+//
+// Usage: replay <workload-file>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "exchange.hpp"
+#include "workload.hpp"
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <workload-file>" << std::endl;
+    return 1;
+  }
+  WorkloadHeader header;
+  std::vector<WorkloadRecord> records;
+  if (!ReadWorkload(argv[1], header, records)) {
+    std::cerr << "could not read workload " << argv[1] << std::endl;
+    return 1;
+  }
+
+  const WorkloadNames names(header.users, header.assets);
+
+  Exchange e;
+  std::vector<OrderId> ids(records.size(), kInvalidOrderId);
+  std::vector<std::uint32_t> latencies;
+  latencies.reserve(records.size());
+  std::uint64_t adds = 0, rejects = 0, cancels = 0, cancel_misses = 0;
+  std::uint64_t replaces = 0, replace_rejects = 0;
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration busy{};
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    const WorkloadRecord &r = records[i];
+    if (r.command == WorkloadCommand::Deposit) {
+      ApplyWorkloadRecord(e, names, records, i, ids);
+      continue;
+    }
+
+    const auto start = Clock::now();
+    const bool applied = ApplyWorkloadRecord(e, names, records, i, ids);
+    const auto took = Clock::now() - start;
+
+    busy += took;
+    latencies.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+    if (r.command == WorkloadCommand::Add) ++adds, rejects += !applied;
+    else if (r.command == WorkloadCommand::Cancel) {
+      ++cancels, cancel_misses += !applied;
+    } else {
+      ++replaces, replace_rejects += !applied;
+    }
+  }
+
+  if (latencies.empty()) {
+    std::cerr << "workload has no orders" << std::endl;
+    return 1;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return latencies[std::min<std::size_t>(latencies.size() * p,
+                                           latencies.size() - 1)];
+  };
+  const double seconds = std::chrono::duration<double>(busy).count();
+  std::cout << "orders:     " << latencies.size() << " (" << adds << " adds, "
+            << rejects << " rejected; " << cancels << " cancels, "
+            << cancel_misses << " already filled; " << replaces
+            << " replaces, " << replace_rejects << " rejected)\n"
+            << "orders/sec: " << latencies.size() / seconds << '\n'
+            << "p50:        " << percentile(0.50) << " ns\n"
+            << "p99:        " << percentile(0.99) << " ns\n"
+            << "p99.9:      " << percentile(0.999) << " ns\n"
+            << "max:        " << latencies.back() << " ns" << std::endl;
+  e.PrintLatencies(std::cout);
+  return 0;
+}
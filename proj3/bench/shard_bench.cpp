@@ -0,0 +1,90 @@
+// Measures how ShardedExchange throughput scales with shard threads. Every
+// run gets the same stream of orders spread evenly over `assets` assets:
+// each asset alternates a resting sell with a buy that fills it, from users
+// funded in USD and every asset. Deposits are applied and flushed before
+// timing starts; the time includes the final Flush(). A plain Exchange on
+// the calling thread gives the baseline.
+//
+// Each shard is a thread and the router is another, so shards only add
+// throughput while shards + 1 <= hardware threads. Past that they share
+// cores with the router and each other, and a run measures only the cost of
+// the hand-off against the savings of shards keeping no fill history. The
+// bench prints the hardware thread count and marks the runs past it.
+//
+// Usage: shard-bench [max_shards=hardware threads] [assets=16]
+//                    [orders=1000000]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sharded.hpp"
+#include "workload.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kUsers = 1000;
+
+template <typename E> void Fund(E &e, const std::vector<std::string> &users,
+                                const std::vector<std::string> &assets) {
+  for (const std::string &user : users) {
+    e.MakeDeposit(user, "USD", 1000000000000);
+    for (const std::string &asset : assets) {
+      e.MakeDeposit(user, asset, 1000000000);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const int max_shards =
+      (argc > 1) ? std::atoi(argv[1])
+                 : std::max(1u, std::thread::hardware_concurrency());
+  const int asset_count = (argc > 2) ? std::atoi(argv[2]) : 16;
+  const long order_count = (argc > 3) ? std::atol(argv[3]) : 1000000;
+
+  std::vector<std::string> users, assets;
+  for (int i = 0; i < kUsers; ++i) users.push_back("user" + std::to_string(i));
+  for (int i = 0; i < asset_count; ++i) {
+    assets.push_back("ASSET" + std::to_string(i));
+  }
+  std::vector<Order> orders;
+  orders.reserve(order_count);
+  for (long i = 0; i < order_count; ++i) {
+    const long pair = i / 2;
+    orders.push_back({users[i % kUsers], (i % 2) ? "Buy" : "Sell",
+                      assets[pair % asset_count], 1,
+                      1000 + static_cast<int>(pair % 64)});
+  }
+
+  const unsigned cpus = std::thread::hardware_concurrency();
+  std::printf("hardware threads: %u\n", cpus);
+  std::printf("%-10s %14s %10s\n", "Shards", "orders/s", "speedup");
+  double baseline;
+  {
+    Exchange e;
+    Fund(e, users, assets);
+    const auto start = Clock::now();
+    for (const Order &order : orders) e.AddOrder(order);
+    baseline = orders.size() / SecondsSince(start);
+    std::printf("%-10s %14.0f %10.2f\n", "Exchange", baseline, 1.0);
+  }
+  for (int shards = 1; shards <= max_shards; ++shards) {
+    ShardedExchange e(shards);
+    Fund(e, users, assets);
+    e.Flush();
+    const auto start = Clock::now();
+    for (const Order &order : orders) e.AddOrder(order);
+    e.Flush();
+    const double rate = orders.size() / SecondsSince(start);
+    std::printf("%-10d %14.0f %10.2f%s\n", shards, rate, rate / baseline,
+                (shards + 1u > cpus) ? "  (oversubscribed)" : "");
+  }
+  return 0;
+}
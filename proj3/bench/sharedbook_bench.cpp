@@ -0,0 +1,160 @@
+// Measures the shared-memory book. First the cost of one consistent read
+// of a quote and of the depth with no writer running; then how long a
+// change takes to reach readers. The writer stamps each command before
+// handing it to the Exchange, drains the events into a MarketDataFeed and
+// publishes, so the latency covers matching, the feed and the seqlock
+// write. Each reader thread maps the region itself, polls the BTC quote
+// version and records now - stamp for every change it sees. Readers spin
+// when there is a hardware thread for each of them and the writer, and
+// yield otherwise.
+//
+// Usage: sharedbook-bench [commands=200000] [gap_us=5]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "exchange.hpp"
+#include "latency.hpp"
+#include "sharedbook.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char *const kRegion = "/exchange-book-bench";
+
+std::uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+void MeasureReads() {
+  SharedBookWriter writer;
+  MarketDataFeed feed(Clock::duration::zero());
+  writer.Create(kRegion, 1);
+  writer.Follow(feed);
+  // A full book: kSharedDepth one-unit levels a side.
+  for (std::int64_t i = 0; i < static_cast<std::int64_t>(kSharedDepth); ++i) {
+    for (Side side : {Side::Buy, Side::Sell}) {
+      const Price price = (side == Side::Buy) ? 100 - i : 101 + i;
+      feed.Apply({0, EventType::BookUpdate, side, 0, 0, 0, 0, 0, 1, price},
+                 Clock::now());
+    }
+  }
+  writer.Publish(feed, NowNs());
+
+  SharedBookReader reader;
+  reader.Open(kRegion);
+  constexpr int kReads = 1000000;
+  // Sums what was read and prints it, so no read can be optimized away.
+  std::int64_t checksum = 0;
+  auto start = Clock::now();
+  for (int i = 0; i < kReads; ++i) {
+    checksum += reader.ReadQuote(0).bid_price.Raw();
+  }
+  const double quote_ns =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+      kReads;
+  BookDepth depth;
+  start = Clock::now();
+  for (int i = 0; i < kReads; ++i) {
+    reader.ReadDepth(0, depth);
+    checksum += depth.asks[kSharedDepth - 1].price.Raw();
+  }
+  const double depth_ns =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+      kReads;
+  std::printf("ReadQuote %.1f ns, ReadDepth (%zu levels a side) %.1f ns"
+              " (checksum %lld)\n",
+              quote_ns, kSharedDepth, depth_ns,
+              static_cast<long long>(checksum));
+}
+
+void RunReader(const std::atomic<bool> &done, bool spin,
+               LatencyHistogram &latency) {
+  SharedBookReader reader;
+  if (!reader.Open(kRegion)) return;
+  const AssetId btc = reader.Find("BTC");
+  std::uint64_t seen = reader.QuoteVersion(btc);
+  while (!done.load(std::memory_order_acquire)) {
+    const std::uint64_t version = reader.QuoteVersion(btc);
+    if (version == seen || (version & 1)) {
+      if (spin) CpuRelax();
+      else std::this_thread::yield();
+      continue;
+    }
+    const BookQuote quote = reader.ReadQuote(btc);
+    latency.Record(NowNs() - quote.stamp);
+    seen = version;
+  }
+}
+
+void MeasureLatency(std::size_t readers, long commands,
+                    std::chrono::microseconds gap) {
+  const bool spin = std::thread::hardware_concurrency() > readers;
+  Exchange e;
+  e.keep_history = false;
+  e.MakeDeposit("maker", "BTC", 1000000000000);
+  e.MakeDeposit("taker", "USD", 1000000000000);
+  EventRing ring(4096, WaitStrategy::Yield);
+  const std::size_t cursor = ring.AddReader();
+  e.events = &ring;
+  MarketDataFeed feed(Clock::duration::zero());
+  SharedBookWriter writer;
+  if (!writer.Create(kRegion, 2)) {
+    std::printf("cannot create %s\n", kRegion);
+    return;
+  }
+  writer.SetName(e.assets.Find("BTC"), "BTC");
+  writer.Follow(feed);
+
+  std::atomic<bool> done{false};
+  std::vector<LatencyHistogram> latencies(readers);
+  std::vector<std::thread> threads;
+  for (std::size_t r = 0; r < readers; ++r) {
+    threads.emplace_back(RunReader, std::cref(done), spin,
+                         std::ref(latencies[r]));
+  }
+
+  // Rests two BTC and takes one of them, so every command moves the ask.
+  for (long i = 0; i < commands; ++i) {
+    const std::uint64_t stamp = NowNs();
+    if (i % 2 == 0) e.AddOrder({"maker", "Sell", "BTC", 2, 1000});
+    else e.AddOrder({"taker", "Buy", "BTC", 1, 1000});
+    feed.Pump(ring, cursor);
+    writer.Publish(feed, stamp);
+    const auto resume = Clock::now() + gap;
+    while (Clock::now() < resume) std::this_thread::yield();
+  }
+  done.store(true, std::memory_order_release);
+  for (std::thread &t : threads) t.join();
+
+  LatencyHistogram all;
+  for (const LatencyHistogram &h : latencies) all.Merge(h);
+  std::printf("%-8zu %-6s %10llu %8llu %8llu %8llu %10llu\n", readers,
+              spin ? "spin" : "yield",
+              static_cast<unsigned long long>(all.Count()),
+              static_cast<unsigned long long>(all.Percentile(0.5)),
+              static_cast<unsigned long long>(all.Percentile(0.99)),
+              static_cast<unsigned long long>(all.Percentile(0.999)),
+              static_cast<unsigned long long>(all.Max()));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const long commands = (argc > 1) ? std::atol(argv[1]) : 200000;
+  const std::chrono::microseconds gap((argc > 2) ? std::atol(argv[2]) : 5);
+
+  MeasureReads();
+  std::printf("\n%-8s %-6s %10s %8s %8s %8s %10s\n", "Readers", "Poll",
+              "observed", "p50", "p99", "p99.9", "max (ns)");
+  for (std::size_t readers : {1, 2, 4}) {
+    MeasureLatency(readers, commands, gap);
+  }
+  return 0;
+}
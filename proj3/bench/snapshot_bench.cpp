@@ -0,0 +1,164 @@
+// Measures snapshot write and restore. Builds an exchange with `accounts`
+// funded users and `orders` resting orders spread over 1000 price levels a
+// side in a few assets, writes a snapshot, then restores it into a fresh
+// exchange and checks that it equals the original (see SameState). Then it
+// checks recovery from a snapshot plus the journal written after it: a
+// journaled workload is snapshotted halfway through, and the snapshot with
+// the journal's tail replayed on top must equal the exchange at the end.
+// Finally it takes a background snapshot while adding and cancelling
+// orders, and compares their latency with and without the child running.
+// A state mismatch fails the run.
+//
+// Usage: snapshot-bench [path=exchange.snapshot] [accounts=1000000]
+//                       [orders=1000000]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "exchange.hpp"
+#include "workload.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Runs a journaled workload of adds, cancels and replaces, snapshotting it
+// halfway, and checks that restoring the snapshot and recovering the
+// journal's tail gives the exchange the whole workload left.
+bool CheckJournalTail(const std::string &path) {
+  const std::string journal_path = path + ".journal";
+  WorkloadConfig config;
+  config.orders = 200000;
+  config.users = 1000;
+  config.replace_ratio = 0.05;
+  const std::vector<WorkloadRecord> records = GenerateWorkload(config);
+  const WorkloadNames names(config.users, config.assets);
+
+  std::remove(journal_path.c_str());
+  Exchange live;
+  {
+    JournalOptions options;
+    options.path = journal_path;
+    options.fsync = FsyncPolicy::Never;
+    JournalWriter journal(options);
+    if (!journal.Open()) return false;
+    live.journal = &journal;
+    std::vector<OrderId> ids(records.size(), kInvalidOrderId);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      if (i == records.size() / 2 && !live.WriteSnapshot(path)) return false;
+      ApplyWorkloadRecord(live, names, records, i, ids);
+    }
+    journal.Sync();
+    live.journal = nullptr;
+  }
+  Exchange recovered;
+  const bool same = recovered.RestoreSnapshot(path) &&
+                    recovered.journal_sequence < live.journal_sequence &&
+                    recovered.RecoverFromJournal(journal_path) &&
+                    SameState(recovered, live);
+  std::remove(path.c_str());
+  std::remove(journal_path.c_str());
+  return same;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const std::string path = (argc > 1) ? argv[1] : "exchange.snapshot";
+  const long accounts = (argc > 2) ? std::atol(argv[2]) : 1000000;
+  const long orders = (argc > 3) ? std::atol(argv[3]) : 1000000;
+  const int kAssets = 4, kLevels = 1000, kMid = 100000;
+
+  auto start = Clock::now();
+  Exchange e;
+  std::vector<std::string> users;
+  for (long i = 0; i < accounts; ++i) {
+    users.push_back("user" + std::to_string(i));
+    e.MakeDeposit(users.back(), "USD", 1000000000);
+  }
+  std::vector<std::string> assets;
+  for (int a = 0; a < kAssets; ++a) {
+    assets.push_back("ASSET" + std::to_string(a));
+    for (long i = 0; i < accounts; ++i) {
+      e.MakeDeposit(users[i], assets[a], 1000);
+    }
+  }
+  for (long i = 0; i < orders; ++i) {
+    const bool sell = i % 2;
+    const int offset = 1 + (i / 2) % kLevels;
+    e.AddOrder({users[i % accounts], sell ? "Sell" : "Buy",
+                assets[i % kAssets], 1, sell ? kMid + offset : kMid - offset});
+  }
+  std::printf("build:   %8.3f s\n", SecondsSince(start));
+
+  start = Clock::now();
+  if (!e.WriteSnapshot(path)) {
+    std::cerr << "could not write snapshot " << path << std::endl;
+    return 1;
+  }
+  struct stat st;
+  ::stat(path.c_str(), &st);
+  std::printf("write:   %8.3f s  %.1f MB\n", SecondsSince(start),
+              st.st_size / 1e6);
+
+  {
+    start = Clock::now();
+    Exchange restored;
+    if (!restored.RestoreSnapshot(path)) {
+      std::cerr << "could not restore snapshot " << path << std::endl;
+      return 1;
+    }
+    std::printf("restore: %8.3f s\n", SecondsSince(start));
+    if (!SameState(restored, e)) {
+      std::cerr << "restored state differs from the original" << std::endl;
+      return 1;
+    }
+  }
+  std::remove(path.c_str());
+
+  if (!CheckJournalTail(path)) {
+    std::cerr << "snapshot + journal tail differs from the original"
+              << std::endl;
+    return 1;
+  }
+  std::printf("restored state and snapshot + journal tail match\n");
+
+  // One resting buy and its cancel, timed together.
+  long next = 0;
+  const auto add_and_cancel = [&](LatencyHistogram &latency) {
+    const auto t = Clock::now();
+    const long i = next++;
+    e.CancelOrder(e.AddOrder({users[i % accounts], "Buy", assets[i % kAssets],
+                              1, kMid - 1 - i % kLevels}));
+    latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       Clock::now() - t)
+                       .count());
+  };
+  LatencyHistogram quiet, during;
+  for (int i = 0; i < 200000; ++i) add_and_cancel(quiet);
+  if (!e.StartBackgroundSnapshot(path)) {
+    std::cerr << "could not start a background snapshot" << std::endl;
+    return 1;
+  }
+  while (e.background_snapshot.Poll()) add_and_cancel(during);
+  std::remove(path.c_str());
+
+  std::printf("\nadd+cancel (ns)        count      p50      p99    p99.9"
+              "        max\n");
+  const std::pair<const char *, const LatencyHistogram *> rows[] = {
+      {"no snapshot", &quiet}, {"during snapshot", &during}};
+  for (const auto &[name, h] : rows) {
+    std::printf("%-16s %11llu %8llu %8llu %8llu %10llu\n", name,
+                static_cast<unsigned long long>(h->Count()),
+                static_cast<unsigned long long>(h->Percentile(0.5)),
+                static_cast<unsigned long long>(h->Percentile(0.99)),
+                static_cast<unsigned long long>(h->Percentile(0.999)),
+                static_cast<unsigned long long>(h->Max()));
+  }
+  e.background_snapshot.Metrics().Print(std::cout);
+  return e.background_snapshot.Metrics().written == 1 ? 0 : 1;
+}
@@ -0,0 +1,297 @@
+#include "workload.hpp"
+#include "exchange.hpp"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <random>
+
+namespace {
+
+// Only the engine (std::mt19937_64) is taken from <random>: its output is
+// fixed by the standard, while the library distributions are not, so the
+// samplers below keep a seed's stream identical across toolchains.
+class Rng {
+public:
+  explicit Rng(std::uint64_t seed) : engine(seed) {}
+
+  // Uniform in [0, 1).
+  double Uniform() { return (engine() >> 11) * 0x1.0p-53; }
+  // Uniform in [lo, hi].
+  std::int32_t Between(std::int32_t lo, std::int32_t hi) {
+    return lo + static_cast<std::int32_t>(Uniform() * (hi - lo + 1));
+  }
+  double Exponential(double rate) { return -std::log1p(-Uniform()) / rate; }
+
+private:
+  std::mt19937_64 engine;
+};
+
+// Samples 0..n-1 with P(k) proportional to 1 / (k + 1)^s.
+class Zipf {
+public:
+  Zipf(std::uint32_t n, double s) : cdf(n) {
+    double sum = 0;
+    for (std::uint32_t k = 0; k < n; ++k) cdf[k] = sum += std::pow(k + 1, -s);
+    for (double &c : cdf) c /= sum;
+  }
+
+  std::uint32_t operator()(Rng &rng) const {
+    const auto it = std::upper_bound(cdf.begin(), cdf.end(), rng.Uniform());
+    return std::min<std::size_t>(it - cdf.begin(), cdf.size() - 1);
+  }
+
+private:
+  std::vector<double> cdf;
+};
+
+// Adds eligible for cancellation are drawn from this many most recent ones.
+constexpr std::size_t kCancelWindow = 1024;
+
+} // namespace
+
+std::vector<WorkloadRecord> GenerateWorkload(const WorkloadConfig &config) {
+  Rng rng(config.seed);
+  const Zipf pick_user(config.users, config.zipf_exponent);
+  const Zipf pick_asset(config.assets, config.zipf_exponent);
+  std::vector<std::int32_t> mids(config.assets, config.mid_price);
+
+  std::vector<WorkloadRecord> records;
+  records.reserve(config.users * (config.assets + 1) + config.orders);
+
+  // Fund every account well past what the stream can spend.
+  const std::int32_t funding = 100000000;
+  for (std::uint32_t user = 0; user < config.users; ++user) {
+    records.push_back({0, user, WorkloadRecord::kUsdAsset,
+                       WorkloadCommand::Deposit, 0, funding, 0, 0});
+    for (std::uint16_t asset = 0; asset < config.assets; ++asset) {
+      records.push_back(
+          {0, user, asset, WorkloadCommand::Deposit, 0, funding, 0, 0});
+    }
+  }
+
+  std::deque<std::uint32_t> recent_adds;
+  for (std::uint64_t i = 0; i < config.orders; ++i) {
+    WorkloadRecord r = {};
+    r.delta_ns = static_cast<std::uint32_t>(
+        std::min(rng.Exponential(config.orders_per_second) * 1e9, 4e9));
+
+    if (!recent_adds.empty() && rng.Uniform() < config.cancel_ratio) {
+      const std::size_t k = rng.Between(0, recent_adds.size() - 1);
+      r.command = WorkloadCommand::Cancel;
+      r.target = recent_adds[k];
+      records.push_back(r);
+      recent_adds[k] = recent_adds.back();
+      recent_adds.pop_back();
+      continue;
+    }
+    // Only drawn when asked for, so streams without replaces stay as they
+    // were before replaces existed.
+    if (config.replace_ratio > 0 && !recent_adds.empty() &&
+        rng.Uniform() < config.replace_ratio) {
+      const WorkloadRecord &added =
+          records[recent_adds[rng.Between(0, recent_adds.size() - 1)]];
+      r.command = WorkloadCommand::Replace;
+      r.target = &added - records.data();
+      r.user = added.user;
+      r.asset = added.asset;
+      r.sell = added.sell;
+      r.amount = rng.Between(1, config.max_amount);
+      r.price = added.price + rng.Between(-2, 2);
+      records.push_back(r);
+      continue;
+    }
+
+    r.command = WorkloadCommand::Add;
+    r.user = pick_user(rng);
+    r.asset = pick_asset(rng);
+    r.sell = rng.Uniform() < 0.5;
+    r.amount = rng.Between(1, config.max_amount);
+
+    // Walk the mid a tick, then quote around it: mostly passive, with
+    // roughly one order in five crossing the mid.
+    std::int32_t &mid = mids[r.asset];
+    mid = std::max(10, mid + (rng.Uniform() < 0.5 ? -1 : 1));
+    const std::int32_t offset = rng.Between(-2, 8);
+    r.price = r.sell ? mid + offset : mid - offset;
+
+    if (recent_adds.size() == kCancelWindow) recent_adds.pop_front();
+    recent_adds.push_back(records.size());
+    records.push_back(r);
+  }
+  return records;
+}
+
+bool WriteWorkload(const std::string &path, const WorkloadConfig &config,
+                   const std::vector<WorkloadRecord> &records) {
+  WorkloadHeader header;
+  header.seed = config.seed;
+  header.users = config.users;
+  header.assets = config.assets;
+  header.record_count = records.size();
+
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(records.data()),
+            records.size() * sizeof(WorkloadRecord));
+  return static_cast<bool>(out);
+}
+
+bool ReadWorkload(const std::string &path, WorkloadHeader &header,
+                  std::vector<WorkloadRecord> &records) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) return false;
+  if (header.magic != WorkloadHeader::kMagic ||
+      header.version != WorkloadHeader::kVersion) {
+    return false;
+  }
+  records.resize(header.record_count);
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char *>(records.data()),
+              records.size() * sizeof(WorkloadRecord)));
+}
+
+std::string WorkloadUserName(std::uint32_t user) {
+  return "user" + std::to_string(user);
+}
+
+std::string WorkloadAssetName(std::uint16_t asset) {
+  return (asset == WorkloadRecord::kUsdAsset) ? "USD"
+                                              : "ASSET" + std::to_string(asset);
+}
+
+WorkloadNames::WorkloadNames(std::uint32_t users, std::uint16_t assets)
+    : usd(WorkloadAssetName(WorkloadRecord::kUsdAsset)) {
+  for (std::uint32_t u = 0; u < users; ++u) {
+    this->users.push_back(WorkloadUserName(u));
+  }
+  for (std::uint16_t a = 0; a < assets; ++a) {
+    this->assets.push_back(WorkloadAssetName(a));
+  }
+}
+
+bool ApplyWorkloadRecord(Exchange &e, const WorkloadNames &names,
+                         const std::vector<WorkloadRecord> &records,
+                         std::size_t i, std::vector<OrderId> &ids) {
+  const WorkloadRecord &r = records[i];
+  switch (r.command) {
+  case WorkloadCommand::Deposit:
+    e.MakeDeposit(names.User(r.user), names.Asset(r.asset), r.amount);
+    return true;
+  case WorkloadCommand::Add:
+    ids[i] = e.AddOrder({names.User(r.user), r.sell ? "Sell" : "Buy",
+                         names.Asset(r.asset), r.amount, r.price});
+    return ids[i] != kInvalidOrderId;
+  case WorkloadCommand::Cancel:
+    return e.CancelOrder(ids[r.target]);
+  case WorkloadCommand::Replace: {
+    const OrderId id = e.ReplaceOrder(ids[r.target], r.price, r.amount);
+    if (id != kInvalidOrderId) ids[r.target] = id;
+    return id != kInvalidOrderId;
+  }
+  }
+  return false;
+}
+
+void ApplyWorkload(Exchange &e, const WorkloadNames &names,
+                   const std::vector<WorkloadRecord> &records,
+                   std::size_t batch) {
+  std::vector<OrderId> ids(records.size(), kInvalidOrderId);
+  std::vector<Order> orders;
+  for (std::size_t i = 0; i < records.size();) {
+    std::size_t end = i;
+    while (end < records.size() && end - i < batch &&
+           records[end].command == WorkloadCommand::Add) {
+      ++end;
+    }
+    if (end - i < 2) {
+      ApplyWorkloadRecord(e, names, records, i++, ids);
+      continue;
+    }
+    orders.clear();
+    for (std::size_t j = i; j < end; ++j) {
+      const WorkloadRecord &r = records[j];
+      orders.emplace_back(names.User(r.user), r.sell ? "Sell" : "Buy",
+                          names.Asset(r.asset), r.amount, r.price);
+    }
+    const std::vector<OrderId> &results = e.AddOrders(orders);
+    std::copy(results.begin(), results.end(), ids.begin() + i);
+    i = end;
+  }
+}
+
+namespace {
+
+bool SameOrder(const BookOrder &a, const BookOrder &b) {
+  return a.user == b.user && a.side == b.side && a.asset == b.asset &&
+         a.amount == b.amount && a.price == b.price;
+}
+
+bool SameResting(const std::vector<const RestingOrder *> &a,
+                 const std::vector<const RestingOrder *> &b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                    [](const RestingOrder *x, const RestingOrder *y) {
+                      return x->id == y->id && SameOrder(x->order, y->order);
+                    });
+}
+
+UserOrderLists ListsOf(const Exchange &e, UserId user) {
+  return (user < e.user_orders.size()) ? e.user_orders[user]
+                                       : UserOrderLists{};
+}
+
+} // namespace
+
+bool SameState(const Exchange &a, const Exchange &b) {
+  if (a.next_order_id != b.next_order_id ||
+      a.journal_sequence != b.journal_sequence ||
+      a.quote_scale != b.quote_scale || a.users.Size() != b.users.Size() ||
+      a.assets.Size() != b.assets.Size() ||
+      a.ledger.Stride() != b.ledger.Stride() ||
+      a.ledger.Rows() != b.ledger.Rows() ||
+      a.ledger.Balances() != b.ledger.Balances() ||
+      a.filled_orders.Size() != b.filled_orders.Size() ||
+      a.trade_history.Size() != b.trade_history.Size() ||
+      !SameResting(a.GetOpenOrders(), b.GetOpenOrders())) {
+    return false;
+  }
+  for (AssetId asset = 0; asset < a.assets.Size(); ++asset) {
+    const AssetSpec &x = a.asset_specs[asset], &y = b.asset_specs[asset];
+    if (a.assets.Name(asset) != b.assets.Name(asset) ||
+        x.qty_decimals != y.qty_decimals || x.lot_size != y.lot_size ||
+        x.tick_size != y.tick_size || x.min_price != y.min_price ||
+        x.max_price != y.max_price) {
+      return false;
+    }
+  }
+  for (UserId user = 0; user < a.users.Size(); ++user) {
+    const UserOrderLists x = ListsOf(a, user), y = ListsOf(b, user);
+    if (a.users.Name(user) != b.users.Name(user) ||
+        a.ledger.HasAccount(user) != b.ledger.HasAccount(user) ||
+        x.fill_head != y.fill_head || x.fill_tail != y.fill_tail ||
+        x.fill_count != y.fill_count ||
+        !SameResting(a.GetOpenOrders(user), b.GetOpenOrders(user))) {
+      return false;
+    }
+  }
+  for (std::size_t i = 0; i < a.filled_orders.Size(); ++i) {
+    const FillRecord &x = a.filled_orders[i], &y = b.filled_orders[i];
+    if (!SameOrder(x.order, y.order) || x.next_for_user != y.next_for_user) {
+      return false;
+    }
+  }
+  for (std::size_t i = 0; i < a.trade_history.Size(); ++i) {
+    const Trade &x = a.trade_history[i], &y = b.trade_history[i];
+    if (x.buyer != y.buyer || x.seller != y.seller || x.asset != y.asset ||
+        x.amount != y.amount || x.price != y.price) {
+      return false;
+    }
+  }
+  return true;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
@@ -0,0 +1,109 @@
+#pragma once
+// Synthetic order flow for load testing. A workload is a seeded, fully
+// deterministic stream of commands: deposits that fund every account, then
+// order adds, cancels and (optionally) replaces with Poisson arrival times,
+// Zipf-distributed users and assets, and prices that random-walk around a
+// per-asset mid.
+//
+// File layout: one WorkloadHeader followed by header.record_count
+// WorkloadRecords, both written in native byte order.
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utility.hpp"
+
+class Exchange;
+
+struct WorkloadConfig {
+  std::uint64_t seed = 1;
+  std::uint64_t orders = 1000000; // adds + cancels + replaces
+  std::uint32_t users = 10000;
+  std::uint32_t assets = 8;
+  double orders_per_second = 1000000; // mean Poisson arrival rate
+  double zipf_exponent = 1.0;         // skew of user and asset popularity
+  double cancel_ratio = 0.3;          // share of commands that are cancels
+  double replace_ratio = 0;           // share of the rest that are replaces
+  std::int32_t mid_price = 1000;
+  std::int32_t max_amount = 10;
+};
+
+enum class WorkloadCommand : std::uint8_t { Deposit, Add, Cancel, Replace };
+
+// 24 bytes. User i is named "user<i>" and asset j "ASSET<j>"; USD deposits
+// use asset kUsdAsset.
+struct WorkloadRecord {
+  static constexpr std::uint16_t kUsdAsset = UINT16_MAX;
+
+  std::uint32_t delta_ns;   // time since the previous record
+  std::uint32_t user;
+  std::uint16_t asset;
+  WorkloadCommand command;
+  std::uint8_t sell;        // Add: 1 for a sell, 0 for a buy
+  std::int32_t amount;      // Deposit, Add, Replace
+  std::int32_t price;       // Add, Replace
+  std::uint32_t target;     // Cancel, Replace: index of the Add record
+};
+static_assert(sizeof(WorkloadRecord) == 24, "workload records are packed");
+
+struct WorkloadHeader {
+  static constexpr std::uint32_t kMagic = 0x314C5758; // "XWL1"
+  static constexpr std::uint32_t kVersion = 1;
+
+  std::uint32_t magic = kMagic;
+  std::uint32_t version = kVersion;
+  std::uint64_t seed = 0;
+  std::uint32_t users = 0;
+  std::uint32_t assets = 0;
+  std::uint64_t record_count = 0;
+};
+
+std::vector<WorkloadRecord> GenerateWorkload(const WorkloadConfig &config);
+
+bool WriteWorkload(const std::string &path, const WorkloadConfig &config,
+                   const std::vector<WorkloadRecord> &records);
+bool ReadWorkload(const std::string &path, WorkloadHeader &header,
+                  std::vector<WorkloadRecord> &records);
+
+std::string WorkloadUserName(std::uint32_t user);
+std::string WorkloadAssetName(std::uint16_t asset);
+
+// Every user and asset name of a workload, built once so that applying
+// records does no string formatting.
+class WorkloadNames {
+public:
+  WorkloadNames(std::uint32_t users, std::uint16_t assets);
+
+  const std::string &User(std::uint32_t user) const { return users[user]; }
+  const std::string &Asset(std::uint16_t asset) const {
+    return (asset == WorkloadRecord::kUsdAsset) ? usd : assets[asset];
+  }
+
+private:
+  std::vector<std::string> users;
+  std::vector<std::string> assets;
+  std::string usd;
+};
+
+// Applies records[i] to `e`. `ids` has one slot per record; an Add stores
+// its order id there for the Cancels and Replaces that target it, and a
+// Replace that requeues the order stores the new id in the same slot.
+// Returns false for a rejected Add or Replace, or a Cancel whose order had
+// already left the book.
+bool ApplyWorkloadRecord(Exchange &e, const WorkloadNames &names,
+                         const std::vector<WorkloadRecord> &records,
+                         std::size_t i, std::vector<OrderId> &ids);
+// Applies every record in order. Runs of up to `batch` consecutive Adds go
+// through one AddOrders call.
+void ApplyWorkload(Exchange &e, const WorkloadNames &names,
+                   const std::vector<WorkloadRecord> &records,
+                   std::size_t batch = 1);
+
+// Whether two exchanges hold the same names, ledger, books (ids and queue
+// order included), per-user order lists, fill history, id counter and
+// journal sequence.
+bool SameState(const Exchange &a, const Exchange &b);
+
+// Wall-clock seconds since `start`.
+double SecondsSince(std::chrono::steady_clock::time_point start);
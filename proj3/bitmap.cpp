@@ -0,0 +1,70 @@
+#include "bitmap.hpp"
+
+void OccupancyBitmap::Resize(std::size_t size) {
+  layers.clear();
+  do {
+    size = (size + 63) / 64;
+    layers.emplace_back(size ? size : 1, 0);
+  } while (size > 1);
+}
+
+void OccupancyBitmap::Set(std::size_t i) {
+  for (std::vector<std::uint64_t> &layer : layers) {
+    std::uint64_t &word = layer[i >> 6];
+    const bool was_empty = (word == 0);
+    word |= std::uint64_t(1) << (i & 63);
+    if (!was_empty) return;
+    i >>= 6;
+  }
+}
+
+void OccupancyBitmap::Clear(std::size_t i) {
+  for (std::vector<std::uint64_t> &layer : layers) {
+    std::uint64_t &word = layer[i >> 6];
+    word &= ~(std::uint64_t(1) << (i & 63));
+    if (word != 0) return;
+    i >>= 6;
+  }
+}
+
+std::size_t OccupancyBitmap::NextAtOrAfter(std::size_t i) const {
+  // Climb until a word has a set bit at or after the position, then descend
+  // taking the lowest set bit of each word below it.
+  for (std::size_t layer = 0; layer < layers.size(); ++layer) {
+    const std::size_t w = i >> 6;
+    if (w >= layers[layer].size()) return kNone;
+    const std::uint64_t bits =
+        layers[layer][w] & (~std::uint64_t(0) << (i & 63));
+    if (bits) {
+      std::size_t found = (w << 6) + __builtin_ctzll(bits);
+      while (layer-- > 0) {
+        found = (found << 6) + __builtin_ctzll(layers[layer][found]);
+      }
+      return found;
+    }
+    i = w + 1;
+  }
+  return kNone;
+}
+
+std::size_t OccupancyBitmap::PrevAtOrBefore(std::size_t i) const {
+  for (std::size_t layer = 0; layer < layers.size(); ++layer) {
+    std::size_t w = i >> 6;
+    std::uint64_t mask = ~std::uint64_t(0) >> (63 - (i & 63));
+    if (w >= layers[layer].size()) {
+      w = layers[layer].size() - 1;
+      mask = ~std::uint64_t(0);
+    }
+    const std::uint64_t bits = layers[layer][w] & mask;
+    if (bits) {
+      std::size_t found = (w << 6) + 63 - __builtin_clzll(bits);
+      while (layer-- > 0) {
+        found = (found << 6) + 63 - __builtin_clzll(layers[layer][found]);
+      }
+      return found;
+    }
+    if (w == 0) return kNone;
+    i = w - 1;
+  }
+  return kNone;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Set of indices in [0, size) stored as a hierarchy of 64-bit words: bit i of
+// layer 0 is index i, and each word of a layer has one bit per word of the
+// layer below that is non-zero. The top layer is a single summary word, so
+// finding the nearest set index on either side takes one count-zeros
+// instruction per layer (four layers cover 2^24 indices) however far away it
+// is.
+class OccupancyBitmap {
+public:
+  static constexpr std::size_t kNone = SIZE_MAX;
+
+  // Holds indices [0, size), all clear.
+  void Resize(std::size_t size);
+
+  bool Empty() const { return layers.back()[0] == 0; }
+  bool Test(std::size_t i) const {
+    return (layers[0][i >> 6] >> (i & 63)) & 1;
+  }
+
+  void Set(std::size_t i);
+  void Clear(std::size_t i);
+
+  // Smallest set index >= i, or kNone.
+  std::size_t NextAtOrAfter(std::size_t i) const;
+  // Largest set index <= i, or kNone.
+  std::size_t PrevAtOrBefore(std::size_t i) const;
+
+private:
+  std::vector<std::vector<std::uint64_t>> layers = {{0}};
+};
@@ -0,0 +1,71 @@
+#include "events.hpp"
+#include <algorithm>
+
+const char *EventTypeName(EventType type) {
+  switch (type) {
+  case EventType::Accepted:
+    return "Accepted";
+  case EventType::Rejected:
+    return "Rejected";
+  case EventType::PartialFill:
+    return "PartialFill";
+  case EventType::Fill:
+    return "Fill";
+  case EventType::Cancelled:
+    return "Cancelled";
+  case EventType::BookUpdate:
+    return "BookUpdate";
+  }
+  return "?";
+}
+
+EventRing::EventRing(std::size_t capacity, WaitStrategy wait)
+    : mask(capacity - 1), slots(new ExecutionEvent[capacity]),
+      event_ready(wait), space_ready(wait) {}
+
+std::size_t EventRing::AddReader() {
+  readers.push_back(std::make_unique<Cursor>());
+  readers.back()->read.store(Published(), std::memory_order_relaxed);
+  return readers.size() - 1;
+}
+
+std::uint64_t EventRing::SlowestReader() const {
+  std::uint64_t slowest_read = Published();
+  for (const std::unique_ptr<Cursor> &cursor : readers) {
+    slowest_read =
+        std::min(slowest_read, cursor->read.load(std::memory_order_acquire));
+  }
+  return slowest_read;
+}
+
+std::uint64_t EventRing::Publish(ExecutionEvent event) {
+  const std::uint64_t sequence =
+      published.load(std::memory_order_relaxed) + 1;
+  if (sequence - slowest > mask + 1) {
+    space_ready.WaitUntil([&] {
+      slowest = SlowestReader();
+      return sequence - slowest <= mask + 1;
+    });
+  }
+  event.sequence = sequence;
+  slots[sequence & mask] = event;
+  published.store(sequence, std::memory_order_release);
+  event_ready.Notify();
+  return sequence;
+}
+
+bool EventRing::TryRead(std::size_t reader, ExecutionEvent &event) {
+  Cursor &cursor = *readers[reader];
+  const std::uint64_t next = cursor.read.load(std::memory_order_relaxed) + 1;
+  if (next > Published()) return false;
+  event = slots[next & mask];
+  cursor.read.store(next, std::memory_order_release);
+  space_ready.Notify();
+  return true;
+}
+
+ExecutionEvent EventRing::Read(std::size_t reader) {
+  ExecutionEvent event;
+  event_ready.WaitUntil([&] { return TryRead(reader, event); });
+  return event;
+}
@@ -0,0 +1,80 @@
+#pragma once
+// Outbound stream of execution reports and book changes. The matching
+// thread publishes ExecutionEvents into an EventRing; each reader
+// (persister, market data, drop copy) follows the stream at its own pace
+// through its own cursor. The ring is bounded: once the slowest reader is a
+// full ring behind, Publish waits for it, so memory stays fixed whatever
+// the volume and no reader ever misses an event.
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ring.hpp"
+#include "utility.hpp"
+
+enum class EventType : std::uint8_t {
+  Accepted,    // order id, amount = size entered
+  Rejected,    // order id if it was already resting (a failed replace), else 0
+  PartialFill, // amount = this fill, remaining = still open
+  Fill,        // as PartialFill, with nothing left open
+  Cancelled,   // amount = size taken off, remaining = still resting
+  BookUpdate,  // price level `price` of side `side` now holds `remaining`
+};
+
+const char *EventTypeName(EventType type);
+
+// One cache line. Fields that do not apply to a type are zero.
+struct ExecutionEvent {
+  std::uint64_t sequence; // 1, 2, 3, ... in publication order
+  EventType type;
+  Side side;
+  UserId user; // not set for BookUpdate
+  AssetId asset;
+  OrderId order;
+  OrderId contra; // fills: the order on the other side of the trade
+  Qty amount;
+  Qty remaining;
+  Price price; // fills: the trade price
+};
+static_assert(sizeof(ExecutionEvent) == kCacheLine, "one event per line");
+
+class EventRing {
+public:
+  // `capacity` must be a power of two.
+  EventRing(std::size_t capacity, WaitStrategy wait);
+  EventRing(const EventRing &) = delete;
+  EventRing &operator=(const EventRing &) = delete;
+
+  // Adds a reader that sees every event published after this call, and
+  // returns its index. Readers should be added before publishing starts.
+  std::size_t AddReader();
+
+  // Producer side, one thread only. Stamps the next sequence number onto
+  // `event`, waiting while some reader is a full ring behind.
+  std::uint64_t Publish(ExecutionEvent event);
+  // Sequence of the last event published.
+  std::uint64_t Published() const {
+    return published.load(std::memory_order_acquire);
+  }
+
+  // Reader side, one thread per reader.
+  bool TryRead(std::size_t reader, ExecutionEvent &event);
+  ExecutionEvent Read(std::size_t reader);
+
+private:
+  struct alignas(kCacheLine) Cursor {
+    std::atomic<std::uint64_t> read{0}; // sequence of the last event read
+  };
+
+  // Smallest read position over all readers.
+  std::uint64_t SlowestReader() const;
+
+  const std::size_t mask;
+  const std::unique_ptr<ExecutionEvent[]> slots;
+  std::vector<std::unique_ptr<Cursor>> readers;
+  alignas(kCacheLine) std::atomic<std::uint64_t> published{0};
+  std::uint64_t slowest = 0; // producer's cached SlowestReader()
+  WakeSignal event_ready;
+  WakeSignal space_ready;
+};
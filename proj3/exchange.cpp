@@ -10,308 +10,848 @@
 #include <iterator>
 #include <vector>
 
+Exchange::Exchange() { InternAsset("USD"); }
+
+AssetId Exchange::InternAsset(std::string_view asset) {
+  const AssetId id = assets.Intern(asset);
+  if (id < books.size()) return id;
+  books.emplace_back(node_pool);
+  asset_specs.push_back({assets.Name(id)});
+  if (id == kUsd) asset_specs[kUsd].qty_decimals = quote_scale;
+  ledger.AddAsset(id);
+  assets_by_name.insert(
+      std::upper_bound(assets_by_name.begin(), assets_by_name.end(), id,
+                       [this](AssetId a, AssetId b) {
+                         return assets.Name(a) < assets.Name(b);
+                       }),
+      id);
+  return id;
+}
+
+BookOrder Exchange::Intern(const Order &order) {
+  return {users.Intern(order.username), ParseSide(order.side),
+          InternAsset(order.asset), order.amount, order.price};
+}
+
+Order Exchange::ToOrder(const BookOrder &order) const {
+  return Order(users.Name(order.user), SideName(order.side),
+               assets.Name(order.asset), order.amount, order.price);
+}
+
+bool Exchange::SetQuoteScale(int decimals) {
+  Journal(JournalOp::SetQuoteScale, std::int64_t{decimals});
+  if (assets.Size() > 1 || decimals < 0 || decimals > kMaxScale) return false;
+  quote_scale = asset_specs[kUsd].qty_decimals = decimals;
+  return true;
+}
+
+bool Exchange::ListAsset(const AssetSpec &spec) {
+  Journal(JournalOp::ListAsset, spec.symbol, spec.quote,
+          std::int64_t{spec.qty_decimals}, spec.lot_size.Raw(),
+          spec.tick_size.Raw(), spec.min_price.Raw(), spec.max_price.Raw());
+  if (spec.symbol.empty() ||
+      assets.Find(spec.symbol) != SymbolTable::kNotFound ||
+      spec.quote != assets.Name(kUsd) || spec.qty_decimals < 0 ||
+      spec.qty_decimals > quote_scale || spec.lot_size <= 0 ||
+      spec.tick_size <= 0 || spec.min_price < 0 ||
+      spec.min_price.Raw() % spec.tick_size.Raw() != 0 ||
+      (spec.HasBand() && spec.max_price < spec.min_price)) {
+    return false;
+  }
+  ApplyAssetSpec(InternAsset(spec.symbol), spec);
+  return true;
+}
+
+void Exchange::ApplyAssetSpec(AssetId id, const AssetSpec &spec) {
+  asset_specs[id] = spec;
+  if (spec.HasBand() && spec.BandLevels() <= kMaxLadderLevels) {
+    OrderBook &book = books[id];
+    book.bids.UseLadder(spec.min_price, spec.tick_size, spec.BandLevels());
+    book.asks.UseLadder(spec.min_price, spec.tick_size, spec.BandLevels());
+  }
+}
+
 void Exchange::MakeDeposit(const std::string &username,
-                           const std::string &asset, int amount) {
-  if (Portfolios.count(username)) Portfolios[username][asset] += amount;
-  else Portfolios[username][asset] = amount;
+                           const std::string &asset, std::int64_t amount) {
+  const UserId user = users.Intern(username);
+  MakeDeposit(user, InternAsset(asset), amount);
+}
+
+void Exchange::MakeDeposit(UserId user, AssetId asset, std::int64_t amount) {
+  Journal(JournalOp::Deposit, users.Name(user), assets.Name(asset), amount);
+  ledger.OpenAccount(user);
+  ledger.Credit(user, asset, amount);
 }
 
 void Exchange::PrintUserPortfolios(std::ostream &os) const {
   os << "User Portfolios (in alphabetical order):" << std::endl;
-  for (const auto &[username, assets] : Portfolios) {
-    os << username << "'s Portfolio: ";
-    for (const auto &[asset, amount] : assets) {
-      if (amount) os << amount << ' ' << asset << ", ";
+  for (UserId user : users.SortedIds()) {
+    if (!ledger.HasAccount(user)) continue;
+    os << users.Name(user) << "'s Portfolio: ";
+    for (AssetId asset : assets_by_name) {
+      const std::int64_t amount = ledger.Balance(user, asset);
+      if (amount) {
+        os << Decimal{amount, QtyScale(asset)} << ' ' << assets.Name(asset)
+           << ", ";
+      }
     }
     os << std::endl;
   }
 }
 
 bool Exchange::WithdrawalIsPossible(const std::string &username,
-                                    const std::string &asset, int amount) {
-  if (Portfolios.count(username)) {
-    const std::map<std::string, int> assets = Portfolios.at(username);
-    if (assets.count(asset)) {
-      const int balance = Portfolios.at(username).at(asset);
-      if ((balance - amount) >= 0) return true;
-    }
+                                    const std::string &asset,
+                                    std::int64_t amount) {
+  const UserId user = users.Find(username);
+  const AssetId asset_id = assets.Find(asset);
+  if (user == SymbolTable::kNotFound || asset_id == SymbolTable::kNotFound) {
+    return false;
   }
-  return false;
+  return ledger.CanDebit(user, asset_id, amount);
 }
 
 bool Exchange::MakeWithdrawal(const std::string &username,
-                              const std::string &asset, int amount) {
+                              const std::string &asset,
+                              std::int64_t amount) {
+  const UserId user = users.Find(username);
+  const AssetId asset_id = assets.Find(asset);
+  if (user == SymbolTable::kNotFound || asset_id == SymbolTable::kNotFound) {
+    Journal(JournalOp::Withdraw, username, asset, amount);
+    return false;
+  }
+  return MakeWithdrawal(user, asset_id, amount);
+}
 
-  if (WithdrawalIsPossible(username, asset, amount)) {
-    Portfolios.at(username).at(asset) -= amount;
-    return true;
+bool Exchange::MakeWithdrawal(UserId user, AssetId asset,
+                              std::int64_t amount) {
+  Journal(JournalOp::Withdraw, users.Name(user), assets.Name(asset), amount);
+  return ledger.Debit(user, asset, amount);
+}
+
+std::optional<Order> Exchange::GetOrder(OrderId id) const {
+  const OrderHandle *handle = order_index.Find(id);
+  if (!handle) return std::nullopt;
+  return ToOrder(handle->pos.it->order);
+}
+
+template <Side S>
+BookPosition Exchange::RestOrder(OrderBook &book, OrderId id,
+                                 const BookOrder &order) {
+  const BookPosition pos = book.Resting<S>().Push(id, order);
+  order_index.Insert(id, {&book, S, pos});
+  LinkOpenOrder(*pos.it);
+  return pos;
+}
+
+template <Side S> void Exchange::RemoveBestOrder(BookSide<S> &side) {
+  order_index.Erase(side.Front().id);
+  UnlinkOpenOrder(side.Front());
+  side.PopFront();
+}
+
+UserOrderLists &Exchange::UserOrdersFor(UserId user) {
+  if (user >= user_orders.size()) user_orders.resize(users.Size());
+  return user_orders[user];
+}
+
+void Exchange::LinkOpenOrder(RestingOrder &r) {
+  UserOrderLists &lists = UserOrdersFor(r.order.user);
+  r.prev_for_user = lists.open_tail;
+  r.next_for_user = nullptr;
+  if (lists.open_tail) lists.open_tail->next_for_user = &r;
+  else lists.open_head = &r;
+  lists.open_tail = &r;
+}
+
+void Exchange::UnlinkOpenOrder(RestingOrder &r) {
+  UserOrderLists &lists = user_orders[r.order.user];
+  if (r.prev_for_user) r.prev_for_user->next_for_user = r.next_for_user;
+  else lists.open_head = r.next_for_user;
+  if (r.next_for_user) r.next_for_user->prev_for_user = r.prev_for_user;
+  else lists.open_tail = r.prev_for_user;
+}
+
+void Exchange::RecordFill(const BookOrder &fill) {
+  const std::uint32_t index = filled_orders.Size();
+  filled_orders.Append({fill, UserOrderLists::kNoFill});
+  UserOrderLists &lists = UserOrdersFor(fill.user);
+  if (lists.fill_tail != UserOrderLists::kNoFill) {
+    filled_orders[lists.fill_tail].next_for_user = index;
+  } else {
+    lists.fill_head = index;
   }
-  return false;
-};
+  lists.fill_tail = index;
+  ++lists.fill_count;
+}
 
-std::vector<Order> Exchange::GetTradeParticipants(Order &taker) {
-  std::vector<Order> filtered;
-  std::copy_if(open_orders.cbegin(), open_orders.cend(),
-               std::back_inserter(filtered), [taker](Order o) {
-                 return (taker.amount) && (o.asset == taker.asset) &&
-                        (o.side != taker.side) &&
-                        ((taker.side == "Buy") ? (o.price <= taker.price)
-                                               : (o.price >= taker.price));
-               });
-  return filtered;
+AllocationCounters Exchange::GetAllocationCounters() const {
+  AllocationCounters counters = node_pool.Counters();
+  counters += filled_orders.Counters();
+  counters += trade_history.Counters();
+  return counters;
 }
 
-bool Exchange::AddOrder(const Order &order) {
-  if (order.side == "Sell") return AddSellOrder(order);
-  else return AddBuyOrder(order);
+std::vector<const RestingOrder *> Exchange::GetOpenOrders(UserId user) const {
+  std::vector<const RestingOrder *> open;
+  if (user >= user_orders.size()) return open;
+  for (const RestingOrder *r = user_orders[user].open_head; r;
+       r = r->next_for_user) {
+    open.push_back(r);
+  }
+  return open;
 }
 
-bool Exchange::AddBuyOrder(const Order &order) {
-  Order taker(order);
-  if (!WithdrawalIsPossible(taker.username, "USD",
-                            (taker.amount * taker.price))) {
-    return false;
+std::vector<BookOrder> Exchange::GetFilledOrders(UserId user,
+                                                 std::size_t first,
+                                                 std::size_t count) const {
+  std::vector<BookOrder> filled;
+  if (user >= user_orders.size()) return filled;
+  const UserOrderLists &lists = user_orders[user];
+  if (first >= lists.fill_count) return filled;
+  filled.reserve(std::min<std::size_t>(count, lists.fill_count - first));
+  std::uint32_t i = lists.fill_head;
+  for (std::size_t skipped = 0; skipped < first; ++skipped) {
+    i = filled_orders[i].next_for_user;
   }
-  while (GetLowestAsk(taker) != open_orders.end()) ExecuteTakerBuy(taker);
-  if (taker.amount) {
-    MakeWithdrawal(taker.username, "USD", (taker.amount * taker.price));
-    open_orders.push_back(taker);
+  for (; i != UserOrderLists::kNoFill && filled.size() < count;
+       i = filled_orders[i].next_for_user) {
+    filled.push_back(filled_orders[i].order);
   }
-  return true;
+  return filled;
 }
 
-bool Exchange::AddSellOrder(const Order &order) {
-  Order taker(order);
-  if (!WithdrawalIsPossible(taker.username, taker.asset, taker.amount)) {
-    return false;
+std::vector<const RestingOrder *> Exchange::GetOpenOrders() const {
+  std::vector<const RestingOrder *> open;
+  for (const OrderBook &book : books) {
+    const auto collect = [&open](const PriceLevel &level) {
+      for (const RestingOrder &r : level.queue) open.push_back(&r);
+    };
+    book.bids.ForEachLevel(collect);
+    book.asks.ForEachLevel(collect);
+  }
+  std::sort(open.begin(), open.end(),
+            [](const RestingOrder *r1, const RestingOrder *r2) {
+              return r1->id < r2->id;
+            });
+  return open;
+}
+
+OrderId Exchange::AddOrder(const Order &order) { return AddOrder(Intern(order)); }
+
+OrderId Exchange::AddBuyOrder(const Order &order) {
+  BookOrder o = Intern(order);
+  o.side = Side::Buy;
+  return AddOrder(o);
+}
+
+OrderId Exchange::AddSellOrder(const Order &order) {
+  BookOrder o = Intern(order);
+  o.side = Side::Sell;
+  return AddOrder(o);
+}
+
+OrderId Exchange::AddOrder(BookOrder order) {
+  Journal(JournalOp::AddOrder, users.Name(order.user),
+          static_cast<std::int64_t>(order.side), assets.Name(order.asset),
+          order.amount.Raw(), order.price.Raw());
+  return SubmitOrder(order);
+}
+
+OrderId Exchange::SubmitOrder(const BookOrder &order) {
+  if (order.side == Side::Sell) return Match<Side::Sell>(order);
+  else return Match<Side::Buy>(order);
+}
+
+const std::vector<OrderId> &Exchange::AddOrders(const Order *orders,
+                                                std::size_t count) {
+  batch_orders.clear();
+  batch_reserves.clear();
+  batch_results.assign(count, kInvalidOrderId);
+
+  // Gateways send bursts from few users in few assets, so each name is only
+  // looked up when it differs from the previous order's.
+  UserId user = 0;
+  AssetId asset = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const Order &order = orders[i];
+    if (i == 0 || order.username != orders[i - 1].username) {
+      user = users.Intern(order.username);
+    }
+    if (i == 0 || order.asset != orders[i - 1].asset) {
+      asset = InternAsset(order.asset);
+    }
+    const BookOrder o = {user, ParseSide(order.side), asset, order.amount,
+                         order.price};
+    std::int64_t reserve;
+    batch_reserves.push_back(CheckOrder(o, reserve) ? reserve : -1);
+    batch_orders.push_back(o);
+    ledger.Prefetch(o.user, ReservedAsset(o));
+  }
+
+  // No user or asset is added from here on, so ledger cells stay put.
+  batch_credit_slots.resize(ledger.Balances().size());
+  batching = true;
+  for (std::size_t i = 0; i < count; ++i) {
+    INSTRUMENT_LATENCY(latencies.add_order);
+    const BookOrder &o = batch_orders[i];
+    Journal(JournalOp::AddOrder, orders[i].username,
+            static_cast<std::int64_t>(o.side), orders[i].asset, o.amount.Raw(),
+            o.price.Raw());
+    if (batch_reserves[i] >= 0) SettleBatchCredit(o.user, ReservedAsset(o));
+    if (batch_reserves[i] < 0 ||
+        !ledger.Debit(o.user, ReservedAsset(o), batch_reserves[i])) {
+      Reject(kInvalidOrderId, o);
+      continue;
+    }
+    batch_results[i] = (o.side == Side::Sell) ? Execute<Side::Sell>(o)
+                                              : Execute<Side::Buy>(o);
+  }
+  batching = false;
+  for (const BatchCredit &credit : batch_credits) {
+    if (credit.amount) ledger.Credit(credit.user, credit.asset, credit.amount);
+    BatchCreditSlot(credit.user, credit.asset) = 0;
+  }
+  batch_credits.clear();
+  return batch_results;
+}
+
+void Exchange::Settle(UserId user, AssetId asset, std::int64_t amount) {
+  if (!batching) {
+    ledger.Credit(user, asset, amount);
+    return;
+  }
+  std::uint32_t &slot = BatchCreditSlot(user, asset);
+  if (!slot) {
+    batch_credits.push_back({user, asset, 0});
+    slot = batch_credits.size();
+  }
+  batch_credits[slot - 1].amount += amount;
+}
+
+std::uint32_t &Exchange::BatchCreditSlot(UserId user, AssetId asset) {
+  return batch_credit_slots[static_cast<std::size_t>(user) * ledger.Stride() +
+                            asset];
+}
+
+void Exchange::SettleBatchCredit(UserId user, AssetId asset) {
+  if (!ledger.HasAccount(user)) return;
+  const std::uint32_t slot = BatchCreditSlot(user, asset);
+  if (!slot || !batch_credits[slot - 1].amount) return;
+  ledger.Credit(user, asset, batch_credits[slot - 1].amount);
+  batch_credits[slot - 1].amount = 0;
+}
+
+const std::vector<OrderId> &Exchange::AddOrders(
+    const std::vector<Order> &orders) {
+  return AddOrders(orders.data(), orders.size());
+}
+
+bool Exchange::CheckOrder(const BookOrder &order,
+                          std::int64_t &reserve) const {
+  return asset_specs[order.asset].Accepts(order.amount, order.price) &&
+         ReservedAmount(order, reserve);
+}
+
+template <Side S> OrderId Exchange::Match(BookOrder taker) {
+  INSTRUMENT_LATENCY(latencies.add_order);
+  taker.side = S;
+  std::int64_t reserve;
+  if (!CheckOrder(taker, reserve) ||
+      !ledger.Debit(taker.user, ReservedAsset(taker), reserve)) {
+    return Reject(kInvalidOrderId, taker);
+  }
+  return Execute<S>(taker);
+}
+
+// The taker's whole reservation is debited up front. Fills are at the taker's
+// price, so what it pays across all fills plus what stays reserved for the
+// rest always equals that reservation, and what it receives is credited once
+// after the last fill.
+template <Side S> OrderId Exchange::Execute(BookOrder taker) {
+  constexpr Side kMakerSide = (S == Side::Buy) ? Side::Sell : Side::Buy;
+  const OrderId id = next_order_id++;
+  Emit(EventType::Accepted, id, taker, taker.amount, taker.amount,
+       taker.price);
+  OrderBook &book = books[taker.asset];
+  BookSide<kMakerSide> &makers = book.Resting<kMakerSide>();
+  std::int64_t received = 0;
+  while (taker.amount) {
+    BookOrder *maker = FindMaker(makers, taker.price);
+    if (!maker) break;
+    const Qty amount = std::min(taker.amount, maker->amount);
+    received += Fill<S>(taker, *maker, amount);
+    makers.ReduceFront(amount);
+    if (events) EmitFills(id, taker, makers, amount);
+    if (!maker->amount) RemoveBestOrder(makers);
+  }
+  if (received) {
+    Settle(taker.user, (S == Side::Buy) ? taker.asset : kUsd, received);
   }
-  while (GetHighestBid(taker) != open_orders.end()) ExecuteTakerSell(taker);
   if (taker.amount) {
-    MakeWithdrawal(taker.username, taker.asset, taker.amount);
-    open_orders.push_back(taker);
+    const BookPosition pos = RestOrder<S>(book, id, taker);
+    EmitBookUpdate(taker.asset, S, taker.price, pos.level->quantity);
   }
+  return id;
+}
+
+// Reports both sides of the fill just taken off the front of `makers`, and
+// what is left at that level.
+template <Side M>
+void Exchange::EmitFills(OrderId taker_id, const BookOrder &taker,
+                         BookSide<M> &makers, Qty amount) {
+  const RestingOrder &maker = makers.Front();
+  Emit(maker.order.amount ? EventType::PartialFill : EventType::Fill,
+       maker.id, maker.order, amount, maker.order.amount, taker.price,
+       taker_id);
+  Emit(taker.amount ? EventType::PartialFill : EventType::Fill, taker_id,
+       taker, amount, taker.amount, taker.price, maker.id);
+  EmitBookUpdate(taker.asset, M, maker.order.price, makers.Top()->quantity);
+}
+
+OrderId Exchange::Reject(OrderId id, const BookOrder &order) {
+  Emit(EventType::Rejected, id, order, order.amount, 0, order.price);
+  return kInvalidOrderId;
+}
+
+// Trades `amount` at the taker's price: settles the maker, whose leg was
+// reserved when it rested, and records the fill. The caller takes `amount`
+// off the maker through its book side, which keeps the level's size current,
+// and settles the taker. The payment needs no overflow check: it is at most
+// the notional of whichever side is the resting buy, or of the buying taker,
+// and both were checked when reserved.
+template <Side S>
+std::int64_t Exchange::Fill(BookOrder &taker, const BookOrder &maker,
+                            Qty amount) {
+  INSTRUMENT_LATENCY(latencies.fill);
+  constexpr bool kTakerBuys = (S == Side::Buy);
+  const Notional usd_payment = amount * taker.price;
+  if constexpr (kTakerBuys) {
+    Settle(maker.user, kUsd, usd_payment.Raw());
+    if (paid_sellers) paid_sellers->push_back(maker.user);
+  } else {
+    Settle(maker.user, taker.asset, amount.Raw());
+  }
+
+  if (keep_history) {
+    RecordFill({maker.user, maker.side, taker.asset, amount, taker.price});
+    RecordFill({taker.user, S, taker.asset, amount, taker.price});
+    trade_history.Append({kTakerBuys ? taker.user : maker.user,
+                          kTakerBuys ? maker.user : taker.user, taker.asset,
+                          amount, taker.price});
+  }
+
+  taker.amount -= amount;
+  return kTakerBuys ? amount.Raw() : usd_payment.Raw();
+}
+
+template <Side S>
+BookOrder *Exchange::FindMaker(BookSide<S> &makers, Price price) {
+  INSTRUMENT_LATENCY(latencies.book_lookup);
+  return makers.Crosses(price) ? &makers.Front().order : nullptr;
+}
+
+void Exchange::PrintLatencies(std::ostream &os) const {
+#ifdef EXCHANGE_INSTRUMENTATION
+  latencies.Print(os);
+#else
+  os << "Engine Latencies: not recorded (build with EXCHANGE_INSTRUMENTATION)"
+     << std::endl;
+#endif
+}
+
+void Exchange::ResetLatencies() {
+#ifdef EXCHANGE_INSTRUMENTATION
+  latencies.Reset();
+#endif
+}
+
+AssetId Exchange::ReservedAsset(const BookOrder &order) const {
+  return (order.side == Side::Buy) ? kUsd : order.asset;
+}
+
+bool Exchange::ReservedAmount(const BookOrder &order,
+                              std::int64_t &amount) const {
+  if (order.side == Side::Sell) {
+    amount = order.amount.Raw();
+    return true;
+  }
+  Notional notional;
+  const bool fits = CheckedNotional(order.amount, order.price, notional);
+  amount = notional.Raw();
+  return fits;
+}
+
+bool Exchange::CancelOrder(OrderId id) {
+  Journal(JournalOp::CancelOrder, static_cast<std::int64_t>(id));
+  return RemoveOrder(id);
+}
+
+bool Exchange::RemoveOrder(OrderId id) {
+  const OrderHandle *handle = order_index.Find(id);
+  if (!handle) return false;
+  const BookOrder &order = handle->pos.it->order;
+  std::int64_t reserve;
+  ReservedAmount(order, reserve);
+  ledger.Credit(order.user, ReservedAsset(order), reserve);
+  Emit(EventType::Cancelled, id, order, order.amount, 0, order.price);
+  EmitBookUpdate(order.asset, order.side, order.price,
+                 handle->pos.level->quantity - order.amount);
+  UnlinkOpenOrder(*handle->pos.it);
+  handle->book->Erase(handle->side, handle->pos);
+  order_index.Erase(id);
   return true;
 }
 
+OrderId Exchange::ReplaceOrder(OrderId id, Price new_price, Qty new_amount) {
+  Journal(JournalOp::ReplaceOrder, static_cast<std::int64_t>(id),
+          new_price.Raw(), new_amount.Raw());
+  const OrderHandle *handle = order_index.Find(id);
+  if (!handle) return Reject(id, {});
+  BookOrder &order = handle->pos.it->order;
+  BookOrder amended = order;
+  amended.amount = new_amount;
+  amended.price = new_price;
+  std::int64_t old_reserve, new_reserve;
+  ReservedAmount(order, old_reserve);
+  if (!asset_specs[order.asset].Accepts(new_amount, new_price) ||
+      !ReservedAmount(amended, new_reserve)) {
+    return Reject(id, amended);
+  }
+
+  // Size-down only: release the difference and keep the queue position.
+  if (new_price == order.price && new_amount <= order.amount) {
+    const Qty reduction = order.amount - new_amount;
+    ledger.Credit(order.user, ReservedAsset(order), old_reserve - new_reserve);
+    handle->book->Reduce(handle->side, handle->pos, reduction);
+    Emit(EventType::Cancelled, id, order, reduction, new_amount, order.price);
+    EmitBookUpdate(order.asset, order.side, order.price,
+                   handle->pos.level->quantity);
+    return id;
+  }
+
+  // Funds released by the cancel count toward the new order's reservation.
+  if (!ledger.CanDebit(order.user, ReservedAsset(order),
+                       new_reserve - old_reserve)) {
+    return Reject(id, amended);
+  }
+  RemoveOrder(id);
+  return SubmitOrder(amended);
+}
+
 void Exchange::PrintUsersOrders(std::ostream &os) const {
   os << "Users Orders (in alphabetical order):" << std::endl;
-  for (const auto &[username, assets] : Portfolios) {
+  for (UserId user : users.SortedIds()) {
+    if (!ledger.HasAccount(user)) continue;
+    const std::string &username = users.Name(user);
     os << username << "'s Open Orders (in chronological order):" << std::endl;
-    for (const auto &o : open_orders) {
-      if (username == o.username) os << o << std::endl;
+    for (const RestingOrder *r : GetOpenOrders(user)) {
+      PrintOrder(os, r->order);
+      os << std::endl;
     }
     os << username << "'s Filled Orders (in chronological order):" << std::endl;
-    for (const auto &o : filled_orders) {
-      if (username == o.username) os << o << std::endl;
+    for (const BookOrder &o : GetFilledOrders(user)) {
+      PrintOrder(os, o);
+      os << std::endl;
     }
   }
 }
 
 void Exchange::PrintTradeHistory(std::ostream &os) const {
   os << "Trade History (in chronological order):" << std::endl;
-  for (const auto &t : trade_history) {
-    os << t.buyer_username << " Bought " << t.amount << " of " << t.asset
-       << " From " << t.seller_username << " for " << t.price << " USD"
-       << std::endl;
+  for (std::size_t i = 0; i < trade_history.Size(); ++i) {
+    const Trade &t = trade_history[i];
+    os << users.Name(t.buyer) << " Bought "
+       << Decimal{t.amount.Raw(), QtyScale(t.asset)} << " of "
+       << assets.Name(t.asset) << " From " << users.Name(t.seller) << " for "
+       << Decimal{t.price.Raw(), PriceScale(t.asset)} << " USD" << std::endl;
   }
 }
 
+void Exchange::PrintOrder(std::ostream &os, const BookOrder &order) const {
+  os << SideName(order.side) << ' '
+     << Decimal{order.amount.Raw(), QtyScale(order.asset)} << ' '
+     << assets.Name(order.asset) << " at "
+     << Decimal{order.price.Raw(), PriceScale(order.asset)} << " USD by "
+     << users.Name(order.user);
+}
+
 void Exchange::PrintBidAskSpread(std::ostream &os) const {
   os << "Asset Bid Ask Spread (in alphabetical order):" << std::endl;
-  for (const std::string &asset : GetNamesOfOpenAssets()) {
-    const std::string highest_buy = GetHighestBuyForAsset(asset);
-    const std::string lowest_sell = GetLowestSellForAsset(asset);
-    os << asset << ": Highest Open Buy = " << highest_buy
-       << " and Lowest Open Sell = " << lowest_sell << std::endl;
-  }
-}
-
-void Exchange::TransactTakerBuy(Order &taker, int usd_payment,
-                                int amount_sold) {
-  auto lowest_seller = GetLowestAsk(taker);
-  std::string buyer{taker.username}, seller{lowest_seller->username};
-  MakeWithdrawal(buyer, "USD", usd_payment);
-  MakeDeposit(seller, "USD", usd_payment);
-  MakeDeposit(buyer, taker.asset, amount_sold);
-}
-
-void Exchange::TransactTakerSell(Order &taker, int usd_payment,
-                                 int amount_bought) {
-  auto highest_buyer = GetHighestBid(taker);
-  std::string seller{taker.username}, buyer{highest_buyer->username};
-  MakeWithdrawal(seller, taker.asset, amount_bought);
-  MakeDeposit(buyer, taker.asset, amount_bought);
-  MakeDeposit(seller, "USD", usd_payment);
-}
-
-void Exchange::FullTakerBuyPartialMakerSell(Order &taker, Trade &trade) {
-  auto lowest_seller = GetLowestAsk(taker);
-  const std::string buyer{taker.username}, seller{lowest_seller->username};
-  const int amount_sold{taker.amount},
-      usd_payment{(taker.amount * taker.price)};
-
-  TransactTakerBuy(taker, usd_payment, amount_sold);
-  
-  Order partial_sell({seller, "Sell", taker.asset, taker.amount, taker.price});
-  
-  filled_orders.push_back(partial_sell);
-  filled_orders.push_back(taker);
-  trade_history.push_back(trade);
-  
-  lowest_seller->amount -= amount_sold;
-  taker.amount = 0;
-}
-
-void Exchange::FullTakerBuyFullMakerSell(Order &taker, Trade &trade) {
-  auto lowest_seller = GetLowestAsk(taker);
-  const std::string buyer{taker.username}, seller{lowest_seller->username};
-  const int amount_sold{taker.amount},
-      usd_payment{(taker.amount * taker.price)};
-
-  TransactTakerBuy(taker, usd_payment, amount_sold);
-  
-  Order complete_sell({seller, "Sell", taker.asset, taker.amount, taker.price});
-  
-  open_orders.erase(lowest_seller);
-  filled_orders.push_back(complete_sell);
-  filled_orders.push_back(taker);
-  trade_history.push_back(trade);
-  
-  taker.amount = 0;
-}
-
-void Exchange::PartialTakerBuyFullMakerSell(Order &taker, Trade &trade) {
-  auto lowest_seller = GetLowestAsk(taker);
-  const std::string buyer{taker.username}, seller{lowest_seller->username};
-  const int amount_sold{lowest_seller->amount},
-      usd_payment{(amount_sold * taker.price)};
-  trade.amount = amount_sold;
-
-  TransactTakerBuy(taker, usd_payment, amount_sold);
-  
-  Order complete_sell({seller, "Sell", taker.asset, amount_sold, taker.price});
-  Order partial_buy({buyer, "Buy", taker.asset, amount_sold, taker.price});
-  
-  open_orders.erase(lowest_seller);
-  filled_orders.push_back(complete_sell);
-  filled_orders.push_back(partial_buy);
-  trade_history.push_back(trade);
-  
-  taker.amount -= amount_sold;
-}
-
-void Exchange::ExecuteTakerBuy(Order &taker) {
-  auto lowest_seller = GetLowestAsk(taker);
-  const std::string buyer{taker.username}, seller{lowest_seller->username};
-  Trade trade = {buyer, seller, taker.asset, taker.amount, taker.price};
-
-  if (taker.amount < lowest_seller->amount) FullTakerBuyPartialMakerSell(taker, trade);
-  else if (taker.amount == lowest_seller->amount) FullTakerBuyFullMakerSell(taker, trade);
-  else PartialTakerBuyFullMakerSell(taker, trade);
-}
-
-void Exchange::FullTakerSellPartialMakerBuy(Order &taker, Trade &trade) {
-  auto highest_buyer = GetHighestBid(taker);
-  const std::string seller{taker.username}, buyer{highest_buyer->username};
-  const int amount_bought{taker.amount},
-      usd_payment{(taker.amount * taker.price)};
-
-  TransactTakerSell(taker, usd_payment, amount_bought);
-  
-  Order partial_maker_buy(
-      {buyer, "Buy", taker.asset, taker.amount, taker.price});
-  
-  filled_orders.push_back(partial_maker_buy);
-  filled_orders.push_back(taker);
-  trade_history.push_back(trade);
-  
-  highest_buyer->amount -= amount_bought;
-  taker.amount = 0;
-}
-
-void Exchange::FullTakerSellFullMakerBuy(Order &taker, Trade &trade) {
-  auto highest_buyer = GetHighestBid(taker);
-  const std::string seller{taker.username}, buyer{highest_buyer->username};
-  const int amount_bought{taker.amount},
-      usd_payment{(taker.amount * taker.price)};
-
-  TransactTakerSell(taker, usd_payment, amount_bought);
-  
-  Order complete_maker_buy(
-      {seller, "Sell", taker.asset, taker.amount, taker.price});
-  
-  open_orders.erase(highest_buyer);
-  filled_orders.push_back(complete_maker_buy);
-  filled_orders.push_back(taker);
-  trade_history.push_back(trade);
-  
-  taker.amount = 0;
-}
-
-void Exchange::PartialTakerSellFullMakerBuy(Order &taker, Trade &trade) {
-  auto highest_buyer = GetHighestBid(taker);
-  const std::string seller{taker.username}, buyer{highest_buyer->username};
-  const int amount_bought{highest_buyer->amount},
-      usd_payment{(amount_bought * taker.price)};
-  trade.amount = amount_bought;
-
-  TransactTakerSell(taker, usd_payment, amount_bought);
-  
-  Order complete_buy({buyer, "Buy", taker.asset, amount_bought, taker.price});
-  Order partial_sell({seller, "Sell", taker.asset, amount_bought, taker.price});
-  
-  open_orders.erase(highest_buyer);
-  filled_orders.push_back(complete_buy);
-  filled_orders.push_back(partial_sell);
-  trade_history.push_back(trade);
-  
-  taker.amount -= amount_bought;
-}
-
-void Exchange::ExecuteTakerSell(Order &taker) {
-  auto highest_buyer = GetHighestBid(taker);
-  const std::string seller{taker.username}, buyer{highest_buyer->username};
-  Trade trade = {buyer, seller, taker.asset, taker.amount, taker.price};
-
-  if (taker.amount < highest_buyer->amount) FullTakerSellPartialMakerBuy(taker, trade);
-  else if (taker.amount == highest_buyer->amount) FullTakerSellFullMakerBuy(taker, trade);
-  else PartialTakerSellFullMakerBuy(taker, trade);
-}
-
-std::vector<int> Exchange::GetOpenBuysForAsset(const std::string &asset) const {
-  std::vector<int> buys;
-  for (const Order &o : open_orders) {
-    if (o.side == "Buy" && o.asset == asset) buys.push_back(o.price);
-  }
-  return buys;
-}
-
-std::vector<int> Exchange::GetOpenSellsForAsset(const std::string &asset) const {
-  std::vector<int> sells;
-  for (const Order &o : open_orders) {
-    if (o.side == "Sell" && o.asset == asset) sells.push_back(o.price);
-  }
-  return sells;
+  for (const TopOfBook &top : GetBidAskSpread()) {
+    const int scale = PriceScale(top.asset);
+    os << assets.Name(top.asset) << ": Highest Open Buy = ";
+    if (top.bid) os << Decimal{top.bid->price.Raw(), scale};
+    else os << "NA";
+    os << " USD and Lowest Open Sell = ";
+    if (top.ask) os << Decimal{top.ask->price.Raw(), scale};
+    else os << "NA";
+    os << " USD" << std::endl;
+  }
+}
+
+TopOfBook Exchange::GetTopOfBook(AssetId asset) const {
+  return books.at(asset).Top(asset);
+}
+
+std::vector<TopOfBook> Exchange::GetBidAskSpread() const {
+  std::vector<TopOfBook> spread;
+  for (AssetId asset : assets_by_name) {
+    const TopOfBook top = GetTopOfBook(asset);
+    if (top.bid || top.ask) spread.push_back(top);
+  }
+  return spread;
 }
 
 std::string Exchange::GetHighestBuyForAsset(const std::string &asset) const {
-  std::ostringstream oss;
-  std::vector<int> buys = GetOpenBuysForAsset(asset);
-  if (buys.size()) oss << *std::max_element(buys.begin(), buys.end()) << " USD";
-  else oss << "NA USD";
-  return oss.str();
+  const AssetId id = assets.Find(asset);
+  const std::optional<Quote> bid = GetTopOfBook(id).bid;
+  return (bid ? ToString({bid->price.Raw(), PriceScale(id)}) : "NA") + " USD";
 }
 
 std::string Exchange::GetLowestSellForAsset(const std::string &asset) const {
-  std::ostringstream oss;
-  std::vector<int> sells = GetOpenSellsForAsset(asset);
-  if (sells.size()) oss << *std::min_element(sells.begin(), sells.end()) << " USD";
-  else oss << "NA USD";
-  return oss.str();
+  const AssetId id = assets.Find(asset);
+  const std::optional<Quote> ask = GetTopOfBook(id).ask;
+  return (ask ? ToString({ask->price.Raw(), PriceScale(id)}) : "NA") + " USD";
 }
 
 std::set<std::string> Exchange::GetNamesOfOpenAssets() const {
   std::set<std::string> open_assets;
-  for (const auto &o : open_orders) open_assets.insert(o.asset);
+  for (const TopOfBook &top : GetBidAskSpread()) {
+    open_assets.insert(assets.Name(top.asset));
+  }
   return open_assets;
 }
+
+bool Exchange::RecoverFromJournal(const std::string &path) {
+  JournalReader reader;
+  if (!reader.Open(path)) return false;
+  // Replayed commands are already in the journal.
+  JournalWriter *const attached = journal;
+  journal = nullptr;
+  JournalEntry entry;
+  bool ok = true;
+  while (ok && reader.Next(entry)) {
+    if (entry.sequence <= journal_sequence) continue; // in the snapshot
+    ok = ApplyJournalEntry(entry);
+    if (ok) journal_sequence = entry.sequence;
+  }
+  journal = attached;
+  if (!ok) return false;
+  return !reader.Truncated() || TrimJournal(path, reader.GoodBytes());
+}
+
+bool Exchange::ApplyJournalEntry(JournalEntry &entry) {
+  // Fields are read into locals first, since the order in which function
+  // arguments are evaluated is unspecified, and checked before anything is
+  // applied.
+  switch (entry.op) {
+  case JournalOp::SetQuoteScale: {
+    const std::int64_t decimals = entry.Int();
+    if (!entry.Finished()) return false;
+    SetQuoteScale(static_cast<int>(decimals));
+    return true;
+  }
+  case JournalOp::ListAsset: {
+    AssetSpec spec;
+    spec.symbol = entry.String();
+    spec.quote = entry.String();
+    spec.qty_decimals = static_cast<int>(entry.Int());
+    spec.lot_size = entry.Int();
+    spec.tick_size = entry.Int();
+    spec.min_price = entry.Int();
+    spec.max_price = entry.Int();
+    if (!entry.Finished()) return false;
+    ListAsset(spec);
+    return true;
+  }
+  case JournalOp::Deposit:
+  case JournalOp::Withdraw: {
+    const std::string user = entry.String();
+    const std::string asset = entry.String();
+    const std::int64_t amount = entry.Int();
+    if (!entry.Finished()) return false;
+    if (entry.op == JournalOp::Deposit) MakeDeposit(user, asset, amount);
+    else MakeWithdrawal(user, asset, amount);
+    return true;
+  }
+  case JournalOp::AddOrder: {
+    const std::string user = entry.String();
+    const std::int64_t side = entry.Int();
+    const std::string asset = entry.String();
+    const Qty amount = entry.Int();
+    const Price price = entry.Int();
+    if (!entry.Finished() || (side != static_cast<int>(Side::Buy) &&
+                              side != static_cast<int>(Side::Sell))) {
+      return false;
+    }
+    AddOrder(Order(user, SideName(static_cast<Side>(side)), asset, amount,
+                   price));
+    return true;
+  }
+  case JournalOp::CancelOrder: {
+    const OrderId id = static_cast<OrderId>(entry.Int());
+    if (!entry.Finished()) return false;
+    CancelOrder(id);
+    return true;
+  }
+  case JournalOp::ReplaceOrder: {
+    const OrderId id = static_cast<OrderId>(entry.Int());
+    const Price price = entry.Int();
+    const Qty amount = entry.Int();
+    if (!entry.Finished()) return false;
+    ReplaceOrder(id, price, amount);
+    return true;
+  }
+  }
+  return false;
+}
+
+bool Exchange::WriteSnapshot(const std::string &path) const {
+  SnapshotHeader header;
+  header.quote_scale = quote_scale;
+  header.journal_sequence = journal_sequence;
+  header.next_order_id = next_order_id;
+  header.user_count = users.Size();
+  header.asset_count = assets.Size();
+  for (UserId user = 0; user < users.Size(); ++user) {
+    header.name_bytes += users.Name(user).size();
+  }
+  for (AssetId asset = 0; asset < assets.Size(); ++asset) {
+    header.name_bytes += assets.Name(asset).size();
+  }
+  header.ledger_rows = ledger.Rows();
+  header.ledger_stride = ledger.Stride();
+  const std::vector<const RestingOrder *> open = GetOpenOrders();
+  header.order_count = open.size();
+  header.fill_count = filled_orders.Size();
+  header.trade_count = trade_history.Size();
+
+  SnapshotWriter out;
+  if (!out.Open(path)) return false;
+  out.Write(header);
+  out.Pad();
+  std::uint64_t name_end = 0;
+  for (UserId user = 0; user < users.Size(); ++user) {
+    out.Write(name_end += users.Name(user).size());
+  }
+  for (AssetId asset = 0; asset < assets.Size(); ++asset) {
+    out.Write(name_end += assets.Name(asset).size());
+  }
+  for (UserId user = 0; user < users.Size(); ++user) {
+    out.Write(users.Name(user).data(), users.Name(user).size());
+  }
+  for (AssetId asset = 0; asset < assets.Size(); ++asset) {
+    out.Write(assets.Name(asset).data(), assets.Name(asset).size());
+  }
+  out.Pad();
+  for (const AssetSpec &spec : asset_specs) {
+    out.Write(SnapshotAsset{spec.qty_decimals, spec.lot_size.Raw(),
+                            spec.tick_size.Raw(), spec.min_price.Raw(),
+                            spec.max_price.Raw()});
+  }
+  for (UserId user = 0; user < ledger.Rows(); ++user) {
+    out.Write(static_cast<std::uint8_t>(ledger.HasAccount(user)));
+  }
+  out.Pad();
+  out.Write(ledger.Balances().data(),
+            ledger.Balances().size() * sizeof(std::int64_t));
+  for (const RestingOrder *r : open) out.Write(SnapshotOrder{r->id, r->order});
+  for (UserId user = 0; user < users.Size(); ++user) {
+    const UserOrderLists lists =
+        (user < user_orders.size()) ? user_orders[user] : UserOrderLists{};
+    out.Write(SnapshotFillList{lists.fill_head, lists.fill_tail,
+                               lists.fill_count, 0});
+  }
+  filled_orders.ForEachChunk([&out](const FillRecord *fills, std::size_t n) {
+    out.Write(fills, n * sizeof(FillRecord));
+  });
+  trade_history.ForEachChunk([&out](const Trade *trades, std::size_t n) {
+    out.Write(trades, n * sizeof(Trade));
+  });
+  return out.Commit();
+}
+
+bool Exchange::RestoreSnapshot(const std::string &path) {
+  if (users.Size() != 0 || assets.Size() != 1) return false;
+  MappedFile file;
+  if (!file.Open(path) || file.Size() < sizeof(SnapshotHeader)) return false;
+  const char *base = file.Data();
+  const auto &header = *reinterpret_cast<const SnapshotHeader *>(base);
+  const SnapshotLayout layout(header);
+  if (header.magic != SnapshotHeader::kMagic ||
+      header.version != SnapshotHeader::kVersion || layout.end != file.Size() ||
+      header.asset_count == 0 || header.ledger_stride < header.asset_count) {
+    return false;
+  }
+  const auto section = [base](std::uint64_t offset) { return base + offset; };
+  const auto *name_ends =
+      reinterpret_cast<const std::uint64_t *>(section(layout.name_ends));
+  const char *names = section(layout.names);
+  const auto name = [&](std::size_t i) {
+    const std::uint64_t begin = i ? name_ends[i - 1] : 0;
+    return std::string(names + begin, name_ends[i] - begin);
+  };
+
+  quote_scale = header.quote_scale;
+  users.Reserve(header.user_count);
+  for (std::size_t user = 0; user < header.user_count; ++user) {
+    users.Intern(name(user));
+  }
+  const auto *specs =
+      reinterpret_cast<const SnapshotAsset *>(section(layout.assets));
+  for (std::size_t asset = 0; asset < header.asset_count; ++asset) {
+    const SnapshotAsset &s = specs[asset];
+    AssetSpec spec{name(header.user_count + asset)};
+    if (InternAsset(spec.symbol) != asset) return false;
+    spec.qty_decimals = static_cast<int>(s.qty_decimals);
+    spec.lot_size = s.lot_size;
+    spec.tick_size = s.tick_size;
+    spec.min_price = s.min_price;
+    spec.max_price = s.max_price;
+    ApplyAssetSpec(asset, spec);
+  }
+  ledger.Load(
+      header.ledger_stride, header.ledger_rows,
+      reinterpret_cast<const std::uint8_t *>(section(layout.open_accounts)),
+      reinterpret_cast<const std::int64_t *>(section(layout.balances)));
+
+  const auto *fill_lists =
+      reinterpret_cast<const SnapshotFillList *>(section(layout.fill_lists));
+  user_orders.resize(header.user_count);
+  for (std::size_t user = 0; user < header.user_count; ++user) {
+    user_orders[user].fill_head = fill_lists[user].head;
+    user_orders[user].fill_tail = fill_lists[user].tail;
+    user_orders[user].fill_count = fill_lists[user].count;
+  }
+  // Orders are in id order, which is also queue order within each level and
+  // each user's open list, so resting them in turn rebuilds both. Users
+  // interned by a rejected order never got a ledger row, so rows are checked
+  // per order rather than against the user count.
+  const auto *orders =
+      reinterpret_cast<const SnapshotOrder *>(section(layout.orders));
+  order_index.Reserve(header.order_count);
+  for (std::size_t i = 0; i < header.order_count; ++i) {
+    const BookOrder &order = orders[i].order;
+    if (order.user >= header.user_count || order.asset >= header.asset_count ||
+        !ledger.HasAccount(order.user)) {
+      return false;
+    }
+    OrderBook &book = books[order.asset];
+    const OrderId id = orders[i].id;
+    if (order.side == Side::Sell) RestOrder<Side::Sell>(book, id, order);
+    else RestOrder<Side::Buy>(book, id, order);
+  }
+  filled_orders.Append(
+      reinterpret_cast<const FillRecord *>(section(layout.fills)),
+      header.fill_count);
+  trade_history.Append(reinterpret_cast<const Trade *>(section(layout.trades)),
+                       header.trade_count);
+  next_order_id = header.next_order_id;
+  journal_sequence = header.journal_sequence;
+  return true;
+}
+
+bool Exchange::StartBackgroundSnapshot(const std::string &path) {
+  return background_snapshot.Start(
+      [this, &path] { return WriteSnapshot(path); });
+}
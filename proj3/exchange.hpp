@@ -1,95 +1,268 @@
 #pragma once
 #include <algorithm>
+#include <deque>
 #include <iterator>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "assetspec.hpp"
+#include "events.hpp"
+#include "journal.hpp"
+#include "latency.hpp"
+#include "orderbook.hpp"
+#include "orderindex.hpp"
+#include "snapshot.hpp"
+#include "symboltable.hpp"
 #include "useraccount.hpp"
 #include "utility.hpp"
 
 class Exchange {
 public:
+  Exchange();
+
   // 1 Portfolio Data Structure
-  std::map<std::string, std::map<std::string, int>> Portfolios;
+  Ledger ledger = {};
+
+  // 1b Symbol Tables (names are only used at the API boundary and printers)
+  static constexpr AssetId kUsd = 0;
+  SymbolTable users = {};
+  SymbolTable assets = {};
+  std::vector<AssetId> assets_by_name = {}; // kept sorted as assets appear
+  AssetId InternAsset(std::string_view asset);
+  BookOrder Intern(const Order &order);
+  Order ToOrder(const BookOrder &order) const;
+
+  // 1c Asset Registry (scales are decimal places; see fixedpoint.hpp)
+  int quote_scale = 0;                   // USD balances and notionals
+  std::vector<AssetSpec> asset_specs = {}; // indexed by AssetId
+  // Bands of at most this many ticks get ladder books. Ladder levels are
+  // built a page at a time as orders reach them, so a listing costs only its
+  // page table and occupancy bitmaps up front: about 150 KiB a side at this
+  // limit.
+  static constexpr std::size_t kMaxLadderLevels = std::size_t(1) << 20;
+  // Sets the USD scale. Only possible while USD is the only asset.
+  bool SetQuoteScale(int decimals);
+  // Lists a new asset on the terms in `spec`. Its prices are at
+  // quote_scale - spec.qty_decimals places, and a bounded band of up to
+  // kMaxLadderLevels ticks gets ladder books. Fails if the symbol already
+  // exists or the spec is unusable: quoted in anything but USD, decimals
+  // outside [0, quote_scale], a non-positive lot or tick, or a band that is
+  // empty or not aligned to the tick. Assets first seen in a deposit or order
+  // are listed with the defaults of AssetSpec.
+  bool ListAsset(const AssetSpec &spec);
+  // Records `spec` for an interned asset and sets up its books to match.
+  void ApplyAssetSpec(AssetId id, const AssetSpec &spec);
+  int QtyScale(AssetId asset) const { return asset_specs[asset].qty_decimals; }
+  int PriceScale(AssetId asset) const {
+    return quote_scale - asset_specs[asset].qty_decimals;
+  }
 
   // 2 Helper Containers
-  std::vector<Order> open_orders = {};
-  std::vector<Order> filled_orders = {};
-  std::vector<Trade> trade_history = {};
+  SlabPool node_pool;               // declared first: the books use it
+  std::deque<OrderBook> books = {}; // indexed by AssetId
+  OrderIndex<OrderHandle> order_index = {};
+  OrderId next_order_id = 1;
+  RecordArena<FillRecord> filled_orders;
+  std::vector<UserOrderLists> user_orders = {}; // indexed by UserId
+  RecordArena<Trade> trade_history;
+  // Whether fills go to filled_orders and trade_history. With an event
+  // stream attached these can be turned off so memory stays bounded; the
+  // printers and GetFilledOrders then see no fills. While on, the arenas take
+  // a new chunk from the global allocator every RecordArena::kChunkRecords
+  // records unless Reserve() was called on them first.
+  bool keep_history = true;
+  // When set, every fill that pays a resting sell USD appends the seller,
+  // whatever keep_history says. Not owned.
+  std::vector<UserId> *paid_sellers = nullptr;
+  // Pool and arena usage, including every call they made to the global
+  // allocator. Other engine storage (order_index, user_orders, the batch
+  // vectors, symbol tables) is not counted; it grows only with the number
+  // of resting orders, users and batch sizes. fills-bench counts operator
+  // new calls to confirm the whole engine is quiet once warm.
+  AllocationCounters GetAllocationCounters() const;
 
-  // 3 Depositor & Withdrawer
+  // 3 Depositor & Withdrawer (amounts in raw units of the asset)
   void MakeDeposit(const std::string &username, const std::string &asset,
-                   int amount);
+                   std::int64_t amount);
   bool WithdrawalIsPossible(const std::string &username,
-                            const std::string &asset, int amount);
+                            const std::string &asset, std::int64_t amount);
   bool MakeWithdrawal(const std::string &username, const std::string &asset,
-                      int amount);
+                      std::int64_t amount);
+  // The same by id, for callers that intern names themselves. Both ids must
+  // be interned; a deposit opens the user's account.
+  void MakeDeposit(UserId user, AssetId asset, std::int64_t amount);
+  bool MakeWithdrawal(UserId user, AssetId asset, std::int64_t amount);
+
+  // 4 Order Adders (return the new order's id, or kInvalidOrderId). Orders
+  // that break their asset's lot, tick or band are rejected.
+  OrderId AddOrder(const Order &order);
+  OrderId AddBuyOrder(const Order &order);
+  OrderId AddSellOrder(const Order &order);
+  OrderId AddOrder(BookOrder order);
+  // Matches an interned order on its own side without journaling it.
+  OrderId SubmitOrder(const BookOrder &order);
 
-  // 4 Order Adders
-  bool AddOrder(const Order &order);
-  bool AddBuyOrder(const Order &order);
-  bool AddSellOrder(const Order &order);
+  // 4a Batch Entry
+  // Adds `count` orders with the same results as calling AddOrder on each in
+  // turn. Names are interned, static terms checked and balances prefetched
+  // for the whole batch before the first order matches, and what fills pay
+  // each (user, asset) is summed and credited once at the end. Returns one
+  // id per order; the vector is reused by the next call.
+  const std::vector<OrderId> &AddOrders(const Order *orders, std::size_t count);
+  const std::vector<OrderId> &AddOrders(const std::vector<Order> &orders);
+  std::vector<BookOrder> batch_orders = {};
+  std::vector<std::int64_t> batch_reserves = {}; // -1 if the order is invalid
+  std::vector<OrderId> batch_results = {};
+  // Credits owed while a batch runs. batch_credit_slots is indexed like the
+  // ledger's balances and holds 1 + the credit's index, or 0.
+  struct BatchCredit {
+    UserId user;
+    AssetId asset;
+    std::int64_t amount;
+  };
+  bool batching = false;
+  std::vector<BatchCredit> batch_credits = {};
+  std::vector<std::uint32_t> batch_credit_slots = {};
+  // Credits `amount` to (user, asset), or adds it to the batch's credits.
+  void Settle(UserId user, AssetId asset, std::int64_t amount);
+  // Applies what the batch owes (user, asset) so far, ahead of a debit.
+  void SettleBatchCredit(UserId user, AssetId asset);
+  std::uint32_t &BatchCreditSlot(UserId user, AssetId asset);
 
-  // 5 Judge For Order Entrants
-  std::vector<Order> GetTradeParticipants(Order &taker);
+  // 4b Order Amenders
+  // Cancels a resting order and returns its reserved funds to the owner.
+  bool CancelOrder(OrderId id);
+  // CancelOrder without journaling, for commands that cancel internally.
+  bool RemoveOrder(OrderId id);
+  // Amends a resting order. A size-down at the same price keeps the order's
+  // id and queue priority; any other change cancels it and submits a new
+  // order, whose id is returned. Returns kInvalidOrderId and leaves the
+  // original untouched if the amendment is rejected.
+  OrderId ReplaceOrder(OrderId id, Price new_price, Qty new_amount);
+  AssetId ReservedAsset(const BookOrder &order) const;
+  // Raw units of ReservedAsset() held while `order` rests. Returns false if
+  // a buy's notional overflows.
+  bool ReservedAmount(const BookOrder &order, std::int64_t &amount) const;
 
-  // 6 Order Executors
-  void ExecuteTakerBuy(Order &order);
-  void ExecuteTakerSell(Order &order);
-  void TransactTakerBuy(Order &taker, int usd_payment, int amount_sold);
-  void TransactTakerSell(Order &taker, int usd_payment, int amount_bought);
+  // 5 Open Orders
+  // Resting order with the given id; empty once it is filled or cancelled.
+  std::optional<Order> GetOrder(OrderId id) const;
+  std::vector<const RestingOrder *> GetOpenOrders() const;
+  // One user's open orders, oldest first, and a range of their fills in
+  // chronological order. Both cost time in the user's own orders only.
+  std::vector<const RestingOrder *> GetOpenOrders(UserId user) const;
+  std::vector<BookOrder> GetFilledOrders(UserId user, std::size_t first = 0,
+                                         std::size_t count = SIZE_MAX) const;
+  template <Side S>
+  BookPosition RestOrder(OrderBook &book, OrderId id, const BookOrder &order);
+  template <Side S> void RemoveBestOrder(BookSide<S> &side);
+  UserOrderLists &UserOrdersFor(UserId user);
+  void LinkOpenOrder(RestingOrder &r);
+  void UnlinkOpenOrder(RestingOrder &r);
+  void RecordFill(const BookOrder &fill);
 
-  // 6a Taker<buy> Helpers
-  void FullTakerBuyPartialMakerSell(Order &taker, Trade &trade);
-  void FullTakerBuyFullMakerSell(Order &taker, Trade &trade);
-  void PartialTakerBuyFullMakerSell(Order &taker, Trade &trade);
+  // 6 Matching Engine
+  // One kernel serves both sides: S is the taker's side, and the book side it
+  // trades against, the price comparison and the settlement legs all follow
+  // from S at compile time.
+  // Checks the terms that do not depend on balances (lot, tick, band and
+  // notional overflow) and sets the amount to reserve for the order.
+  bool CheckOrder(const BookOrder &order, std::int64_t &reserve) const;
+  template <Side S> OrderId Match(BookOrder taker);
+  // Matches and rests an order whose reservation has already been debited.
+  template <Side S> OrderId Execute(BookOrder taker);
+  // Returns what the taker receives, in raw units.
+  template <Side S>
+  std::int64_t Fill(BookOrder &taker, const BookOrder &maker, Qty amount);
+  // Best resting order on `makers` that trades at `price`, or nullptr.
+  template <Side S> BookOrder *FindMaker(BookSide<S> &makers, Price price);
 
-  // 6b Taker<sell> Helpers
-  void FullTakerSellPartialMakerBuy(Order &taker, Trade &trade);
-  void FullTakerSellFullMakerBuy(Order &taker, Trade &trade);
-  void PartialTakerSellFullMakerBuy(Order &taker, Trade &trade); 
+  // 6b Instrumentation (recorded only with EXCHANGE_INSTRUMENTATION)
+#ifdef EXCHANGE_INSTRUMENTATION
+  EngineLatencies latencies = {};
+#endif
+  void PrintLatencies(std::ostream &os) const;
+  void ResetLatencies();
 
   // 7 Printers
   void PrintUserPortfolios(std::ostream &os) const;
   void PrintUsersOrders(std::ostream &os) const;
   void PrintTradeHistory(std::ostream &os) const;
   void PrintBidAskSpread(std::ostream &os) const;
+  // Writes `order` like Order's operator<<, with amounts at their scales.
+  void PrintOrder(std::ostream &os, const BookOrder &order) const;
 
   // 7b PrintBidAskPrice() Helpers
+  // Best bid and ask of one asset, read from the book in O(1).
+  TopOfBook GetTopOfBook(AssetId asset) const;
+  // Top of book for every asset with open orders, in alphabetical order.
+  std::vector<TopOfBook> GetBidAskSpread() const;
   std::set<std::string> GetNamesOfOpenAssets() const;
   std::string GetHighestBuyForAsset(const std::string &asset) const;
   std::string GetLowestSellForAsset(const std::string &asset) const;
-  std::vector<int> GetOpenBuysForAsset(const std::string &asset) const;
-  std::vector<int> GetOpenSellsForAsset(const std::string &asset) const;
-
-  // 8 Highest<bid> Lowest<ask> Filters
-  auto GetLowestAsk(Order &taker) {
-    auto p = GetTradeParticipants(taker);
-    if (p.size()) {
-      auto min_p_iter = std::min_element(p.begin(), p.end(),
-                                         [](const Order &o1, const Order &o2) {
-                                           return (o1.price < o2.price);
-                                         });
-      return std::find(open_orders.begin(), open_orders.end(), *min_p_iter);
+
+  // 8 Journal
+  // When set, every state-changing command is appended to `journal` before
+  // it is applied. Not owned; it must outlive its use by the exchange. A
+  // writer that has failed refuses further commands (see
+  // JournalWriter::Append); check journal->Failed() to learn of it.
+  JournalWriter *journal = nullptr;
+  // Sequence of the last command journaled or replayed.
+  std::uint64_t journal_sequence = 0;
+  template <typename... Fields>
+  void Journal(JournalOp op, const Fields &...fields) {
+    if (!journal) return;
+    if (const std::uint64_t sequence = journal->Append(op, fields...)) {
+      journal_sequence = sequence;
     }
-    return open_orders.end();
   }
+  // Replays the journal at `path` into this exchange, which should be fresh
+  // or restored from a snapshot (commands the snapshot already holds are
+  // skipped), and cuts off any torn tail so a writer can append after it.
+  // Open the writer with journal_sequence to continue the numbering. Returns
+  // false, leaving the file alone, if a whole record does not decode to a
+  // command; journal_sequence is then the last command applied.
+  bool RecoverFromJournal(const std::string &path);
+  // Applies one replayed command. Returns false, applying nothing, if its
+  // op is unknown or its fields do not fill the payload exactly.
+  bool ApplyJournalEntry(JournalEntry &entry);
 
-  auto GetHighestBid(Order &taker) {
-    auto p = GetTradeParticipants(taker);
-    if (p.size()) {
-      auto max_p_iter = std::max_element(p.begin(), p.end(),
-                                         [](const Order &o1, const Order &o2) {
-                                           if (o1.price != o2.price) {
-                                             return o1.price < o2.price;
-                                           } else {
-                                             return o1.username < o2.username;
-                                           }
-                                         });
-      return std::find(open_orders.begin(), open_orders.end(), *max_p_iter);
-    }
-    return open_orders.end();
+  // 8b Event Stream (see events.hpp)
+  // When set, every acceptance, rejection, fill, cancel and book level
+  // change is published to `events`. Not owned.
+  EventRing *events = nullptr;
+  void Emit(EventType type, OrderId id, const BookOrder &order, Qty amount,
+            Qty remaining, Price price, OrderId contra = kInvalidOrderId) {
+    if (!events) return;
+    events->Publish({0, type, order.side, order.user, order.asset, id, contra,
+                     amount, remaining, price});
   }
+  void EmitBookUpdate(AssetId asset, Side side, Price price, Qty quantity) {
+    if (!events) return;
+    events->Publish({0, EventType::BookUpdate, side, 0, asset, 0, 0, 0,
+                     quantity, price});
+  }
+  template <Side M>
+  void EmitFills(OrderId taker_id, const BookOrder &taker, BookSide<M> &makers,
+                 Qty amount);
+  // Reports a rejected order or amendment; returns kInvalidOrderId.
+  OrderId Reject(OrderId id, const BookOrder &order);
+
+  // 9 Snapshots (see snapshot.hpp for the format)
+  // Writes the whole state, including journal_sequence, to `path`,
+  // replacing it atomically.
+  bool WriteSnapshot(const std::string &path) const;
+  // Loads a snapshot into a fresh exchange by mapping the file and resting
+  // its orders in one pass. Returns false if the file is missing or damaged,
+  // possibly after restoring part of it; discard the exchange then.
+  bool RestoreSnapshot(const std::string &path);
+  // Writes a snapshot of the current state to `path` from a forked child
+  // while this process keeps matching (see BackgroundSnapshot). Poll
+  // background_snapshot to learn when it is done; its metrics show the
+  // stall each snapshot cost.
+  bool StartBackgroundSnapshot(const std::string &path);
+  BackgroundSnapshot background_snapshot;
 };
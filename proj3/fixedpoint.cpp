@@ -0,0 +1,22 @@
+#include "fixedpoint.hpp"
+#include <ostream>
+
+std::string ToString(Decimal d) {
+  // Work on the magnitude as unsigned so INT64_MIN has no special case.
+  const bool negative = d.raw < 0;
+  const std::uint64_t magnitude = negative ? 0 - static_cast<std::uint64_t>(d.raw)
+                                     : static_cast<std::uint64_t>(d.raw);
+  std::string digits = std::to_string(magnitude);
+  if (d.scale > 0) {
+    if (digits.size() <= static_cast<std::size_t>(d.scale)) {
+      digits.insert(0, d.scale + 1 - digits.size(), '0');
+    }
+    digits.insert(digits.size() - d.scale, 1, '.');
+  }
+  return negative ? '-' + digits : digits;
+}
+
+std::ostream &operator<<(std::ostream &os, Decimal d) {
+  if (d.scale == 0) return os << d.raw;
+  return os << ToString(d);
+}
@@ -0,0 +1,82 @@
+#pragma once
+// Fixed-point quantities. Every value is an int64 count of the smallest unit
+// of what it measures; the number of decimal places (the scale) belongs to
+// the asset, not to the value, so arithmetic stays plain integer arithmetic.
+//
+//   Qty       asset amount, at the asset's quantity scale
+//   Price     USD per whole unit of the asset, at its price scale
+//   Notional  USD amount, at the exchange's quote scale
+//
+// An asset's scales always satisfy qty_scale + price_scale == quote_scale,
+// so Qty * Price is a Notional in raw units with no rescaling.
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+template <typename Tag> class Fixed {
+public:
+  constexpr Fixed() = default;
+  // Implicit so that integer literals read as raw units: Qty q = 5;
+  constexpr Fixed(std::int64_t raw) : raw(raw) {}
+
+  constexpr std::int64_t Raw() const { return raw; }
+  constexpr explicit operator bool() const { return raw != 0; }
+
+  constexpr Fixed operator-() const { return Fixed(-raw); }
+  constexpr Fixed operator+(Fixed o) const { return Fixed(raw + o.raw); }
+  constexpr Fixed operator-(Fixed o) const { return Fixed(raw - o.raw); }
+  Fixed &operator+=(Fixed o) {
+    raw += o.raw;
+    return *this;
+  }
+  Fixed &operator-=(Fixed o) {
+    raw -= o.raw;
+    return *this;
+  }
+
+  constexpr bool operator==(Fixed o) const { return raw == o.raw; }
+  constexpr bool operator!=(Fixed o) const { return raw != o.raw; }
+  constexpr bool operator<(Fixed o) const { return raw < o.raw; }
+  constexpr bool operator<=(Fixed o) const { return raw <= o.raw; }
+  constexpr bool operator>(Fixed o) const { return raw > o.raw; }
+  constexpr bool operator>=(Fixed o) const { return raw >= o.raw; }
+
+private:
+  std::int64_t raw = 0;
+};
+
+using Qty = Fixed<struct QtyTag>;
+using Price = Fixed<struct PriceTag>;
+using Notional = Fixed<struct NotionalTag>;
+
+// Largest number of decimal places any scale may use.
+constexpr int kMaxScale = 18;
+
+// Notional of `qty` at `price`. Sets `notional` and returns false if the
+// product does not fit in 64 bits; the overflow check is a flag test on the
+// multiply, not a division.
+inline bool CheckedNotional(Qty qty, Price price, Notional &notional) {
+  std::int64_t raw;
+  const bool overflow = __builtin_mul_overflow(qty.Raw(), price.Raw(), &raw);
+  notional = raw;
+  return !overflow;
+}
+
+// Unchecked product, for amounts already bounded by a checked reservation.
+inline Notional operator*(Qty qty, Price price) {
+  return qty.Raw() * price.Raw();
+}
+
+// Writes raw units; see Decimal for scaled output.
+template <typename Tag>
+std::ostream &operator<<(std::ostream &os, Fixed<Tag> value) {
+  return os << value.Raw();
+}
+
+// A raw value printed with `scale` decimal places, e.g. {150, 2} as "1.50".
+struct Decimal {
+  std::int64_t raw;
+  int scale;
+};
+std::ostream &operator<<(std::ostream &os, Decimal d);
+std::string ToString(Decimal d);
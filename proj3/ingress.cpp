@@ -0,0 +1,190 @@
+#include "ingress.hpp"
+#include <cstring>
+
+namespace {
+
+// Copies `name` into a fixed field; false if it does not fit.
+template <std::size_t N>
+bool PutName(char (&field)[N], const std::string &name) {
+  if (name.size() > N) return false;
+  std::memset(field, 0, N);
+  std::memcpy(field, name.data(), name.size());
+  return true;
+}
+
+template <std::size_t N> std::string_view GetName(const char (&field)[N]) {
+  const void *end = std::memchr(field, 0, N);
+  const std::size_t length = end ? static_cast<const char *>(end) - field : N;
+  return std::string_view(field, length);
+}
+
+IngressMessage Message(IngressType type, std::uint64_t tag,
+                       const std::string &user, const std::string &asset,
+                       std::int64_t amount) {
+  IngressMessage m = {};
+  m.type = type;
+  m.tag = tag;
+  m.amount = amount;
+  if (!PutName(m.user, user) || !PutName(m.asset, asset)) {
+    m.type = IngressType::Invalid;
+  }
+  return m;
+}
+
+} // namespace
+
+IngressMessage IngressMessage::AddOrder(std::uint64_t tag, const Order &order) {
+  IngressMessage m = Message(IngressType::AddOrder, tag, order.username,
+                             order.asset, order.amount.Raw());
+  m.side = ParseSide(order.side);
+  m.price = order.price.Raw();
+  return m;
+}
+
+IngressMessage IngressMessage::Cancel(std::uint64_t tag, OrderId id) {
+  IngressMessage m = {};
+  m.type = IngressType::Cancel;
+  m.tag = tag;
+  m.id = id;
+  return m;
+}
+
+IngressMessage IngressMessage::Deposit(std::uint64_t tag,
+                                       const std::string &user,
+                                       const std::string &asset,
+                                       std::int64_t amount) {
+  return Message(IngressType::Deposit, tag, user, asset, amount);
+}
+
+IngressMessage IngressMessage::Withdraw(std::uint64_t tag,
+                                        const std::string &user,
+                                        const std::string &asset,
+                                        std::int64_t amount) {
+  return Message(IngressType::Withdraw, tag, user, asset, amount);
+}
+
+IngressEngine::IngressEngine(Exchange &exchange, IngressOptions options)
+    : exchange(exchange), options(options), shared(options.capacity),
+      request_ready(options.wait), space_ready(options.wait) {
+  for (std::size_t i = 0; i < options.gateways; ++i) {
+    gateways.push_back(std::make_unique<Gateway>(options.capacity,
+                                                 options.wait));
+  }
+}
+
+IngressEngine::~IngressEngine() { Stop(); }
+
+void IngressEngine::Start() {
+  stopping = false;
+  matcher = std::thread(&IngressEngine::Run, this);
+}
+
+void IngressEngine::Stop() {
+  if (!matcher.joinable()) return;
+  stopping = true;
+  request_ready.Notify();
+  matcher.join();
+}
+
+void IngressEngine::Send(std::size_t gateway, IngressMessage message) {
+  message.gateway = gateway;
+  if (options.topology == IngressTopology::SharedMpsc) {
+    space_ready.WaitUntil([&] { return shared.TryPush(message); });
+  } else {
+    SpscRing<IngressMessage> &ring = gateways[gateway]->requests;
+    space_ready.WaitUntil([&] { return ring.TryPush(message); });
+  }
+  request_ready.Notify();
+}
+
+bool IngressEngine::TryReceiveAck(std::size_t gateway, IngressAck &ack) {
+  Gateway &g = *gateways[gateway];
+  if (!g.acks.TryPop(ack)) return false;
+  g.ack_space.Notify();
+  return true;
+}
+
+IngressAck IngressEngine::ReceiveAck(std::size_t gateway) {
+  Gateway &g = *gateways[gateway];
+  IngressAck ack;
+  g.ack_ready.WaitUntil([&] { return g.acks.TryPop(ack); });
+  g.ack_space.Notify();
+  return ack;
+}
+
+bool IngressEngine::Pending() {
+  if (options.topology == IngressTopology::SharedMpsc) return !shared.Empty();
+  for (const std::unique_ptr<Gateway> &g : gateways) {
+    if (!g->requests.Empty()) return true;
+  }
+  return false;
+}
+
+void IngressEngine::Run() {
+  IngressMessage message;
+  for (;;) {
+    int applied = 0;
+    if (options.topology == IngressTopology::SharedMpsc) {
+      while (applied < kBurst && shared.TryPop(message)) {
+        Apply(message);
+        ++applied;
+      }
+    } else {
+      for (const std::unique_ptr<Gateway> &g : gateways) {
+        for (int n = 0; n < kBurst && g->requests.TryPop(message); ++n) {
+          Apply(message);
+          ++applied;
+        }
+      }
+    }
+    if (applied) {
+      space_ready.Notify();
+      continue;
+    }
+    // Stop only once the rings are empty, so everything sent before Stop()
+    // is applied. The drain above may have missed a Send that landed just
+    // before `stopping` was read, so the rings are checked again.
+    if (stopping && !Pending()) return;
+    request_ready.WaitUntil([&] { return stopping || Pending(); });
+  }
+}
+
+// Names are looked up in place and only copied the first time they are
+// interned, so known users and assets cost no allocation.
+void IngressEngine::Apply(const IngressMessage &m) {
+  IngressAck ack = {m.tag, kInvalidOrderId, false};
+  switch (m.type) {
+  case IngressType::Invalid:
+    break;
+  case IngressType::AddOrder:
+    ack.id = exchange.AddOrder(
+        BookOrder{exchange.users.Intern(GetName(m.user)), m.side,
+                  exchange.InternAsset(GetName(m.asset)), m.amount, m.price});
+    ack.ok = ack.id != kInvalidOrderId;
+    break;
+  case IngressType::Cancel:
+    ack.ok = exchange.CancelOrder(m.id);
+    break;
+  case IngressType::Deposit:
+    exchange.MakeDeposit(exchange.users.Intern(GetName(m.user)),
+                         exchange.InternAsset(GetName(m.asset)), m.amount);
+    ack.ok = true;
+    break;
+  case IngressType::Withdraw: {
+    const UserId user = exchange.users.Find(GetName(m.user));
+    const AssetId asset = exchange.assets.Find(GetName(m.asset));
+    if (user != SymbolTable::kNotFound && asset != SymbolTable::kNotFound) {
+      ack.ok = exchange.MakeWithdrawal(user, asset, m.amount);
+    } else {
+      // By name, so the refusal is journaled as before.
+      ack.ok = exchange.MakeWithdrawal(std::string(GetName(m.user)),
+                                       std::string(GetName(m.asset)),
+                                       m.amount);
+    }
+    break;
+  }
+  }
+  Gateway &g = *gateways[m.gateway];
+  g.ack_space.WaitUntil([&] { return g.acks.TryPush(ack); });
+  g.ack_ready.Notify();
+}
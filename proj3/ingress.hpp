@@ -0,0 +1,117 @@
+#pragma once
+// Command ingress for an Exchange. Gateway threads enqueue fixed-size
+// messages into lock-free rings; one matching thread drains them in arrival
+// order, applies each to the exchange, and answers with an ack on the
+// sending gateway's own SPSC ring. The exchange must only be used from the
+// matching thread while the engine runs.
+//
+// Two topologies: one SPSC ring per gateway, drained round-robin, or one
+// MPSC ring shared by all gateways. Both sides block with the WaitStrategy
+// chosen at construction.
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exchange.hpp"
+#include "ring.hpp"
+
+enum class IngressType : std::uint8_t {
+  Invalid, // a name did not fit; always rejected
+  AddOrder,
+  Cancel,
+  Deposit,
+  Withdraw,
+};
+
+// One cache line. Names are stored unterminated when they fill their field.
+struct IngressMessage {
+  static constexpr std::size_t kUserChars = 16;
+  static constexpr std::size_t kAssetChars = 8;
+
+  IngressType type;
+  Side side;
+  std::uint32_t gateway; // set by IngressEngine::Send
+  std::uint64_t tag;     // echoed in the ack
+  std::int64_t amount;   // AddOrder, Deposit, Withdraw
+  std::int64_t price;    // AddOrder
+  OrderId id;            // Cancel
+  char user[kUserChars];
+  char asset[kAssetChars];
+
+  static IngressMessage AddOrder(std::uint64_t tag, const Order &order);
+  static IngressMessage Cancel(std::uint64_t tag, OrderId id);
+  static IngressMessage Deposit(std::uint64_t tag, const std::string &user,
+                                const std::string &asset, std::int64_t amount);
+  static IngressMessage Withdraw(std::uint64_t tag, const std::string &user,
+                                 const std::string &asset,
+                                 std::int64_t amount);
+};
+static_assert(sizeof(IngressMessage) == kCacheLine, "one message per line");
+
+struct IngressAck {
+  std::uint64_t tag;
+  OrderId id; // AddOrder: the new order, or kInvalidOrderId
+  bool ok;    // accepted, cancelled, deposited or withdrawn
+};
+
+enum class IngressTopology { SpscPerGateway, SharedMpsc };
+
+struct IngressOptions {
+  std::size_t gateways = 1;
+  IngressTopology topology = IngressTopology::SpscPerGateway;
+  WaitStrategy wait = WaitStrategy::Futex;
+  std::size_t capacity = 4096; // per ring, a power of two
+};
+
+class IngressEngine {
+public:
+  IngressEngine(Exchange &exchange, IngressOptions options);
+  IngressEngine(const IngressEngine &) = delete;
+  IngressEngine &operator=(const IngressEngine &) = delete;
+  ~IngressEngine();
+
+  // Starts the matching thread.
+  void Start();
+  // Applies everything already enqueued, then stops the matching thread.
+  void Stop();
+
+  // Gateway calls; each gateway index must be used by one thread at a time.
+  // Send waits while the request ring is full, and the matching thread waits
+  // while the gateway's ack ring is full, so a gateway that sends and
+  // receives on one thread must keep fewer than `capacity` messages
+  // unacknowledged.
+  void Send(std::size_t gateway, IngressMessage message);
+  bool TryReceiveAck(std::size_t gateway, IngressAck &ack);
+  IngressAck ReceiveAck(std::size_t gateway);
+
+private:
+  struct Gateway {
+    Gateway(std::size_t capacity, WaitStrategy wait)
+        : requests(capacity), acks(capacity), ack_ready(wait),
+          ack_space(wait) {}
+
+    SpscRing<IngressMessage> requests; // SpscPerGateway only
+    SpscRing<IngressAck> acks;
+    WakeSignal ack_ready; // the matching thread pushed an ack
+    WakeSignal ack_space; // the gateway popped one
+  };
+
+  // Messages taken from one ring before moving to the next.
+  static constexpr int kBurst = 64;
+
+  void Run();
+  bool Pending();
+  void Apply(const IngressMessage &message);
+
+  Exchange &exchange;
+  const IngressOptions options;
+  std::vector<std::unique_ptr<Gateway>> gateways;
+  MpscRing<IngressMessage> shared; // SharedMpsc only
+  WakeSignal request_ready; // a gateway sent a message
+  WakeSignal space_ready;   // the matching thread freed request slots
+  std::atomic<bool> stopping{false};
+  std::thread matcher;
+};
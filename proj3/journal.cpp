@@ -0,0 +1,271 @@
+#include "journal.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// FNV-1a; enough to tell a torn or partly written record from a whole one.
+std::uint32_t Checksum(const char *data, std::size_t size) {
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+bool WriteFully(int fd, const char *data, std::size_t size) {
+  while (size) {
+    const ssize_t n = ::write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+} // namespace
+
+JournalWriter::JournalWriter(JournalOptions options)
+    : options(std::move(options)) {}
+
+JournalWriter::~JournalWriter() {
+  if (writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    work.notify_one();
+    writer.join();
+  }
+  if (fd >= 0) ::close(fd);
+}
+
+bool JournalWriter::Open(std::uint64_t last_sequence) {
+  fd = ::open(options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) return false;
+  if (::lseek(fd, 0, SEEK_END) == 0) {
+    const JournalFileHeader header;
+    if (!WriteFully(fd, reinterpret_cast<const char *>(&header),
+                    sizeof(header))) {
+      return false;
+    }
+  }
+  appended = durable = last_sequence;
+  writer = std::thread(&JournalWriter::Run, this);
+  return true;
+}
+
+void JournalWriter::Put(std::int64_t value) {
+  pending.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void JournalWriter::Put(const std::string &value) {
+  const std::uint32_t size = value.size();
+  pending.append(reinterpret_cast<const char *>(&size), sizeof(size));
+  pending.append(value);
+}
+
+void JournalWriter::SealRecord(std::size_t start, std::uint64_t sequence) {
+  char *record = &pending[start];
+  const std::uint32_t payload_size =
+      pending.size() - start - kRecordHeaderSize;
+  std::memcpy(record, &payload_size, 4);
+  std::memcpy(record + 8, &sequence, 8);
+  const std::uint32_t checksum = Checksum(record + 8, payload_size + 8);
+  std::memcpy(record + 4, &checksum, 4);
+}
+
+void JournalWriter::WaitDurable(std::uint64_t sequence) {
+  std::unique_lock<std::mutex> lock(mutex);
+  written.wait(lock, [&] { return durable >= sequence || failed; });
+}
+
+bool JournalWriter::Sync() {
+  std::unique_lock<std::mutex> lock(mutex);
+  const std::uint64_t target = appended;
+  written.wait(lock, [&] { return durable >= target || failed; });
+  return !failed;
+}
+
+std::uint64_t JournalWriter::LastAppended() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return appended;
+}
+
+std::uint64_t JournalWriter::LastDurable() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return durable;
+}
+
+bool JournalWriter::Failed() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return failed;
+}
+
+std::uint64_t JournalWriter::Commits() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return commits;
+}
+
+std::uint64_t JournalWriter::Fsyncs() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return fsyncs;
+}
+
+void JournalWriter::Run() {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point last_fsync = Clock::now();
+  bool unsynced = false;
+  std::string batch;
+  for (;;) {
+    std::uint64_t batch_end;
+    bool stop;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      // Under the interval policy, wake up in time to sync what is written.
+      const auto ready = [&] { return !pending.empty() || stopping; };
+      if (unsynced) {
+        work.wait_until(lock, last_fsync + options.fsync_interval, ready);
+      } else {
+        work.wait(lock, ready);
+      }
+      if (pending.empty() && stopping && !unsynced) return;
+      batch.swap(pending);
+      batch_end = appended;
+      stop = stopping;
+    }
+
+    bool ok = WriteFully(fd, batch.data(), batch.size());
+    bool synced = false;
+    if (!batch.empty()) unsynced = true;
+    const bool sync_due =
+        options.fsync == FsyncPolicy::EveryCommit ||
+        (options.fsync == FsyncPolicy::Interval &&
+         (stop || Clock::now() - last_fsync >= options.fsync_interval));
+    if (ok && unsynced && sync_due) {
+      ok = ::fdatasync(fd) == 0;
+      last_fsync = Clock::now();
+      unsynced = false;
+      synced = true;
+    }
+    if (options.fsync == FsyncPolicy::Never) unsynced = false;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!batch.empty()) ++commits;
+      fsyncs += synced;
+      failed |= !ok;
+      // A record is durable once written under Never, or once synced.
+      if (ok && (options.fsync != FsyncPolicy::Interval || synced)) {
+        durable = batch_end;
+      }
+    }
+    written.notify_all();
+    batch.clear();
+    if (!ok) return;
+  }
+}
+
+std::int64_t JournalEntry::Int() {
+  std::int64_t value = 0;
+  if (pos + sizeof(value) > payload.size()) {
+    ok = false;
+    return 0;
+  }
+  std::memcpy(&value, payload.data() + pos, sizeof(value));
+  pos += sizeof(value);
+  return value;
+}
+
+std::string JournalEntry::String() {
+  std::uint32_t size = 0;
+  if (pos + sizeof(size) > payload.size()) {
+    ok = false;
+    return {};
+  }
+  std::memcpy(&size, payload.data() + pos, sizeof(size));
+  pos += sizeof(size);
+  if (pos + size > payload.size()) {
+    ok = false;
+    return {};
+  }
+  std::string value = payload.substr(pos, size);
+  pos += size;
+  return value;
+}
+
+JournalReader::~JournalReader() {
+  if (fd >= 0) ::close(fd);
+}
+
+bool JournalReader::Open(const std::string &path) {
+  fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  JournalFileHeader header;
+  if (!ReadFully(&header, sizeof(header)) ||
+      header.magic != JournalFileHeader::kMagic ||
+      header.version != JournalFileHeader::kVersion) {
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) return false;
+  file_size = st.st_size;
+  good_bytes = sizeof(header);
+  return true;
+}
+
+bool JournalReader::ReadFully(void *data, std::size_t size) {
+  char *out = static_cast<char *>(data);
+  while (size) {
+    const ssize_t n = ::read(fd, out, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    out += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool JournalReader::Next(JournalEntry &entry) {
+  char header[16];
+  const ssize_t first = ::read(fd, header, 1);
+  if (first <= 0) return false; // clean end of file
+  if (!ReadFully(header + 1, sizeof(header) - 1)) {
+    truncated = true;
+    return false;
+  }
+  std::uint32_t payload_size, checksum;
+  std::memcpy(&payload_size, header, 4);
+  std::memcpy(&checksum, header + 4, 4);
+  std::memcpy(&entry.sequence, header + 8, 8);
+  // The size comes from a header that may itself be torn; one claiming more
+  // than the file holds marks the tail, and is never allocated.
+  if (payload_size > file_size - good_bytes - sizeof(header)) {
+    truncated = true;
+    return false;
+  }
+
+  std::string &payload = entry.payload;
+  payload.assign(8 + payload_size, '\0');
+  std::memcpy(&payload[0], header + 8, 8);
+  if (payload_size == 0 || !ReadFully(&payload[8], payload_size) ||
+      Checksum(payload.data(), payload.size()) != checksum) {
+    truncated = true;
+    return false;
+  }
+  entry.op = static_cast<JournalOp>(payload[8]);
+  entry.pos = 9;
+  entry.ok = true;
+  good_bytes += sizeof(header) + payload_size;
+  return true;
+}
+
+bool TrimJournal(const std::string &path, std::uint64_t size) {
+  return ::truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+}
@@ -0,0 +1,178 @@
+#pragma once
+// Write-ahead journal of the commands that change exchange state. Each
+// command is appended, with the next sequence number, before it is applied;
+// replaying a journal into a fresh Exchange rebuilds the same state because
+// the engine is deterministic.
+//
+// File layout: a JournalFileHeader, then records of
+//   u32 payload size | u32 checksum | u64 sequence | payload
+// where the payload is one JournalOp byte followed by the command's fields,
+// each an i64 or a string (u32 length, then the bytes), all in native byte
+// order. The checksum covers the sequence and the payload, so a record torn
+// by a crash is detected and ends recovery.
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+enum class JournalOp : std::uint8_t {
+  SetQuoteScale, // decimals
+  ListAsset,     // symbol, quote, qty_decimals, lot, tick, min, max
+  Deposit,       // user, asset, amount
+  Withdraw,      // user, asset, amount
+  AddOrder,      // user, side, asset, amount, price
+  CancelOrder,   // id
+  ReplaceOrder,  // id, price, amount
+};
+
+struct JournalFileHeader {
+  static constexpr std::uint32_t kMagic = 0x314C4A58; // "XJL1"
+  static constexpr std::uint32_t kVersion = 1;
+
+  std::uint32_t magic = kMagic;
+  std::uint32_t version = kVersion;
+};
+
+// When the writer thread forces written records to disk.
+enum class FsyncPolicy {
+  Never,       // leave it to the OS; survives a process crash only
+  EveryCommit, // fdatasync after every group commit
+  Interval,    // fdatasync at most once per JournalOptions::fsync_interval
+};
+
+struct JournalOptions {
+  std::string path;
+  FsyncPolicy fsync = FsyncPolicy::EveryCommit;
+  std::chrono::milliseconds fsync_interval{10};
+  // Make Append() wait until its record is durable under the fsync policy.
+  // Otherwise callers only wait in Sync().
+  bool synchronous = false;
+};
+
+// Appends records from the exchange thread and writes them from a dedicated
+// writer thread. Records appended while a write or fsync is in progress are
+// written together in the next one (group commit), so the cost of a disk
+// round trip is shared by every command that arrived during it.
+class JournalWriter {
+public:
+  explicit JournalWriter(JournalOptions options);
+  JournalWriter(const JournalWriter &) = delete;
+  JournalWriter &operator=(const JournalWriter &) = delete;
+  // Writes out everything appended, then stops the writer thread.
+  ~JournalWriter();
+
+  // Opens (creating or appending to) the file and starts the writer thread.
+  // New records are numbered after `last_sequence`.
+  bool Open(std::uint64_t last_sequence = 0);
+
+  // Queues one record and returns its sequence number. Fields are
+  // std::int64_t or std::string. Once a write or fsync has failed nothing
+  // more can be made durable, so records are refused and 0 is returned.
+  template <typename... Fields>
+  std::uint64_t Append(JournalOp op, const Fields &...fields) {
+    std::uint64_t sequence;
+    std::size_t start;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (failed) return 0;
+      sequence = ++appended;
+      start = pending.size();
+      pending.append(kRecordHeaderSize, '\0');
+      pending.push_back(static_cast<char>(op));
+      (Put(fields), ...);
+      SealRecord(start, sequence);
+    }
+    // The writer only sleeps with nothing pending, so only the first record
+    // of a group needs to wake it.
+    if (start == 0) work.notify_one();
+    if (options.synchronous) WaitDurable(sequence);
+    return sequence;
+  }
+
+  // Waits until every record appended so far is durable. Returns false if
+  // the journal has failed.
+  bool Sync();
+
+  std::uint64_t LastAppended() const;
+  std::uint64_t LastDurable() const;
+  bool Failed() const;
+
+  // Writes and fsyncs made, for measuring how well commits are grouped.
+  std::uint64_t Commits() const;
+  std::uint64_t Fsyncs() const;
+
+private:
+  static constexpr std::size_t kRecordHeaderSize = 16;
+
+  void Put(std::int64_t value);
+  void Put(const std::string &value);
+  void SealRecord(std::size_t start, std::uint64_t sequence);
+  void WaitDurable(std::uint64_t sequence);
+  void Run();
+
+  JournalOptions options;
+  int fd = -1;
+  std::thread writer;
+
+  mutable std::mutex mutex;
+  std::condition_variable work;    // pending records or stopping
+  std::condition_variable written; // durable advanced or failed
+  std::string pending;             // encoded records not yet written
+  std::uint64_t appended = 0;
+  std::uint64_t durable = 0;
+  std::uint64_t commits = 0;
+  std::uint64_t fsyncs = 0;
+  bool stopping = false;
+  bool failed = false;
+};
+
+// One decoded record. Fields are read back in the order they were written.
+class JournalEntry {
+public:
+  std::uint64_t sequence = 0;
+  JournalOp op = JournalOp::Deposit;
+
+  std::int64_t Int();
+  std::string String();
+  // Whether every read so far stayed inside the payload.
+  bool Ok() const { return ok; }
+  // Whether the reads stayed inside the payload and used all of it.
+  bool Finished() const { return ok && pos == payload.size(); }
+
+private:
+  friend class JournalReader;
+  std::string payload;
+  std::size_t pos = 0;
+  bool ok = true;
+};
+
+// Reads a journal front to back, stopping at the end of the file or at the
+// first torn or corrupt record.
+class JournalReader {
+public:
+  JournalReader() = default;
+  JournalReader(const JournalReader &) = delete;
+  JournalReader &operator=(const JournalReader &) = delete;
+  ~JournalReader();
+
+  bool Open(const std::string &path);
+  bool Next(JournalEntry &entry);
+  // Whether reading stopped on a damaged record rather than a clean end.
+  bool Truncated() const { return truncated; }
+  // Length of the file up to the end of the last whole record read.
+  std::uint64_t GoodBytes() const { return good_bytes; }
+
+private:
+  bool ReadFully(void *data, std::size_t size);
+
+  int fd = -1;
+  bool truncated = false;
+  std::uint64_t good_bytes = 0;
+  std::uint64_t file_size = 0;
+};
+
+// Cuts the file to `size` bytes, e.g. to drop a torn tail found by a reader
+// before appending to the journal again.
+bool TrimJournal(const std::string &path, std::uint64_t size);
@@ -0,0 +1,51 @@
+#include "latency.hpp"
+#include <algorithm>
+#include <iomanip>
+
+std::uint64_t LatencyHistogram::BucketUpperBound(int bucket) {
+  const int range = bucket >> kSubBits;
+  const std::uint64_t sub = bucket & kSubMask;
+  if (range == 0) return sub;
+  const int shift = range - 1;
+  return (((kSubMask + 1 + sub) << shift) + (1ull << shift)) - 1;
+}
+
+std::uint64_t LatencyHistogram::Percentile(double p) const {
+  if (!count) return 0;
+  const std::uint64_t rank = std::max<std::uint64_t>(1, p * count + 0.5);
+  std::uint64_t seen = 0;
+  for (int bucket = 0; bucket < kBuckets; ++bucket) {
+    seen += counts[bucket];
+    if (seen >= rank) return std::min(BucketUpperBound(bucket), max);
+  }
+  return max;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (int bucket = 0; bucket < kBuckets; ++bucket) {
+    counts[bucket] += other.counts[bucket];
+  }
+  count += other.count;
+  max = std::max(max, other.max);
+}
+
+void EngineLatencies::Reset() {
+  add_order.Reset();
+  fill.Reset();
+  book_lookup.Reset();
+}
+
+void EngineLatencies::Print(std::ostream &os) const {
+  os << "Engine Latencies (ns):" << std::endl;
+  os << std::left << std::setw(14) << "" << std::right << std::setw(12)
+     << "count" << std::setw(10) << "p50" << std::setw(10) << "p99"
+     << std::setw(10) << "p99.9" << std::setw(12) << "max" << std::endl;
+  const std::pair<const char *, const LatencyHistogram *> rows[] = {
+      {"AddOrder", &add_order}, {"Fill", &fill}, {"Book lookup", &book_lookup}};
+  for (const auto &[name, h] : rows) {
+    os << std::left << std::setw(14) << name << std::right << std::setw(12)
+       << h->Count() << std::setw(10) << h->Percentile(0.5) << std::setw(10)
+       << h->Percentile(0.99) << std::setw(10) << h->Percentile(0.999)
+       << std::setw(12) << h->Max() << std::endl;
+  }
+}
@@ -1,12 +1,49 @@
+#include <algorithm>
+#include <deque>
 #include <iostream>
 #include <sstream>
 
 #define CHECK(a) (std::cout << std::boolalpha << (a) << "\n")
 
 #include "exchange.hpp"
+#include "sharded.hpp"
 #include "useraccount.hpp"
 #include "utility.hpp"
 
+// Everything the printers show, for comparing two exchanges.
+std::string State(const Exchange &e) {
+  std::ostringstream os;
+  e.PrintUserPortfolios(os);
+  e.PrintUsersOrders(os);
+  e.PrintTradeHistory(os);
+  e.PrintBidAskSpread(os);
+  for (const RestingOrder *r : e.GetOpenOrders()) os << r->id << ' ';
+  os << e.next_order_id;
+  return os.str();
+}
+
+// Open orders without their ids, sorted, for comparing books whose ids were
+// handed out differently.
+std::vector<std::string> Book(const Exchange &e) {
+  std::vector<std::string> orders;
+  for (const RestingOrder *r : e.GetOpenOrders()) {
+    std::ostringstream os;
+    os << e.users.Name(r->order.user)
+       << (r->order.side == Side::Buy ? " Buy " : " Sell ")
+       << e.assets.Name(r->order.asset) << ' ' << r->order.amount << '@'
+       << r->order.price;
+    orders.push_back(os.str());
+  }
+  std::sort(orders.begin(), orders.end());
+  return orders;
+}
+
+// Deterministic pseudo-random numbers in [0, n).
+int Random(std::uint64_t &seed, int n) {
+  seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+  return static_cast<int>((seed >> 33) % n);
+}
+
 int main() {
   Exchange e;
   std::ostringstream oss;
@@ -76,5 +113,200 @@ int main() {
         "USD and Lowest Open Sell = 1423 USD\nLTC: Highest Open Buy = 600 USD "
         "and Lowest Open Sell = NA USD\n");
 
+  // Cancels and replaces
+  Exchange c;
+  c.MakeDeposit("Ann", "USD", 10000);
+  c.MakeDeposit("Ben", "BTC", 50);
+  c.MakeDeposit("Cal", "USD", 10000);
+  const auto balance = [&c](const std::string &user, const std::string &asset) {
+    return c.ledger.Balance(c.users.Find(user), c.assets.Find(asset));
+  };
+  // A cancel refunds what the order reserved: USD for a buy, the asset for a
+  // sell.
+  const OrderId bid = c.AddOrder({"Ann", "Buy", "BTC", 10, 100});
+  const OrderId ask = c.AddOrder({"Ben", "Sell", "BTC", 20, 120});
+  CHECK(balance("Ann", "USD") == 9000 && balance("Ben", "BTC") == 30);
+  CHECK(c.CancelOrder(bid) && !c.GetOrder(bid) &&
+        balance("Ann", "USD") == 10000);
+  CHECK(c.CancelOrder(ask) && !c.GetOrder(ask) && balance("Ben", "BTC") == 50);
+  CHECK(!c.CancelOrder(bid));
+  // A size-down keeps the id and the place in the queue.
+  const OrderId ann = c.AddOrder({"Ann", "Buy", "BTC", 10, 100});
+  const OrderId cal = c.AddOrder({"Cal", "Buy", "BTC", 10, 100});
+  CHECK(c.ReplaceOrder(ann, 100, 5) == ann && balance("Ann", "USD") == 9500);
+  c.AddOrder({"Ben", "Sell", "BTC", 5, 100});
+  CHECK(!c.GetOrder(ann) && balance("Ann", "BTC") == 5 &&
+        balance("Cal", "BTC") == 0);
+  // A size-up or a price change gets a new id at the back of the queue.
+  const OrderId ann_up = c.AddOrder({"Ann", "Buy", "BTC", 10, 100});
+  const OrderId cal_up = c.ReplaceOrder(cal, 100, 12);
+  CHECK(cal_up != kInvalidOrderId && cal_up != cal && !c.GetOrder(cal) &&
+        balance("Cal", "USD") == 8800);
+  c.AddOrder({"Ben", "Sell", "BTC", 10, 100});
+  CHECK(!c.GetOrder(ann_up) && balance("Ann", "BTC") == 15 &&
+        balance("Cal", "BTC") == 0);
+  const OrderId cal_moved = c.ReplaceOrder(cal_up, 90, 12);
+  CHECK(cal_moved != kInvalidOrderId && cal_moved != cal_up &&
+        !c.GetOrder(cal_up) && c.GetOrder(cal_moved)->price == 90 &&
+        balance("Cal", "USD") == 8920);
+  // A rejected replace leaves the order resting with its reservation.
+  CHECK(c.ReplaceOrder(cal_moved, 90, 1000) == kInvalidOrderId &&
+        c.GetOrder(cal_moved) ==
+            std::optional<Order>(Order("Cal", "Buy", "BTC", 12, 90)) &&
+        balance("Cal", "USD") == 8920);
+  CHECK(c.ReplaceOrder(cal_moved, 90, 0) == kInvalidOrderId &&
+        c.GetOrder(cal_moved)->amount == 12 && balance("Cal", "USD") == 8920);
+
+  // Ladder books match map books on a stream of adds, cancels and replaces.
+  Exchange ladder, map;
+  AssetSpec banded{"BTC"};
+  banded.min_price = 1;
+  banded.max_price = 2000;
+  ladder.ListAsset(banded);
+  map.ListAsset({"BTC"});
+  for (Exchange *x : {&ladder, &map}) {
+    for (int u = 0; u < 8; ++u) {
+      x->MakeDeposit("u" + std::to_string(u), "USD", 100000000);
+      x->MakeDeposit("u" + std::to_string(u), "BTC", 100000);
+    }
+  }
+  std::uint64_t seed = 1;
+  std::vector<OrderId> ids;
+  bool same_ids = true;
+  for (int i = 0; i < 5000; ++i) {
+    const int kind = Random(seed, 10);
+    if (kind < 7 || ids.empty()) {
+      const Order order("u" + std::to_string(Random(seed, 8)),
+                        Random(seed, 2) ? "Sell" : "Buy", "BTC",
+                        1 + Random(seed, 10), 950 + Random(seed, 100));
+      ids.push_back(ladder.AddOrder(order));
+      same_ids &= map.AddOrder(order) == ids.back();
+    } else if (kind < 9) {
+      const OrderId id = ids[Random(seed, ids.size())];
+      same_ids &= ladder.CancelOrder(id) == map.CancelOrder(id);
+    } else {
+      const OrderId id = ids[Random(seed, ids.size())];
+      const Price price = 950 + Random(seed, 100);
+      const Qty amount = 1 + Random(seed, 10);
+      ids.push_back(ladder.ReplaceOrder(id, price, amount));
+      same_ids &= map.ReplaceOrder(id, price, amount) == ids.back();
+    }
+  }
+  CHECK(same_ids && State(ladder) == State(map));
+
+  // Batches give the ids and state of adding their orders one at a time,
+  // though fills are settled at the end of each batch. Funds are tight, so
+  // many orders only pass on what earlier fills in their batch paid.
+  Exchange batched, sequential;
+  for (Exchange *x : {&batched, &sequential}) {
+    for (int u = 0; u < 6; ++u) {
+      x->MakeDeposit("u" + std::to_string(u), "USD", 2000);
+      x->MakeDeposit("u" + std::to_string(u), "BTC", 20);
+      x->MakeDeposit("u" + std::to_string(u), "ETH", 20);
+    }
+  }
+  std::vector<Order> burst;
+  for (int i = 0; i < 3000; ++i) {
+    burst.emplace_back("u" + std::to_string(Random(seed, 6)),
+                       Random(seed, 2) ? "Sell" : "Buy",
+                       Random(seed, 2) ? "ETH" : "BTC", 1 + Random(seed, 10),
+                       90 + Random(seed, 20));
+  }
+  bool same_results = true;
+  int rejected = 0;
+  for (std::size_t first = 0; first < burst.size(); first += 50) {
+    const std::vector<OrderId> &results =
+        batched.AddOrders(burst.data() + first, 50);
+    for (std::size_t i = 0; i < 50; ++i) {
+      same_results &= sequential.AddOrder(burst[first + i]) == results[i];
+      rejected += results[i] == kInvalidOrderId;
+    }
+  }
+  CHECK(same_results && rejected > 0 && State(batched) == State(sequential));
+
+  // Shards match a single exchange, USD deposits and withdrawals included,
+  // when no user's USD is wanted by two shards: each user trades one asset.
+  // BTC and LTC share a shard.
+  const std::vector<std::string> coins = {"BTC", "ETH", "LTC"};
+  Exchange single;
+  ShardedExchange sharded(2);
+  std::vector<OrderId> single_ids;
+  std::deque<OrderId> sharded_ids;
+  std::vector<bool> single_ok;
+  std::deque<bool> sharded_ok;
+  for (int u = 0; u < 6; ++u) {
+    const std::string user = "u" + std::to_string(u);
+    single.MakeDeposit(user, "USD", 3000);
+    sharded.MakeDeposit(user, "USD", 3000);
+    single.MakeDeposit(user, coins[u % 3], 30);
+    sharded.MakeDeposit(user, coins[u % 3], 30);
+  }
+  int usd_refused = 0;
+  for (int i = 0; i < 4000; ++i) {
+    const int u = Random(seed, 6);
+    const std::string user = "u" + std::to_string(u);
+    const std::string &coin = coins[u % 3];
+    const int kind = Random(seed, 10);
+    if (kind < 2) {
+      const std::string &asset = (kind == 0) ? "USD" : coin;
+      const int amount = 1 + Random(seed, asset == "USD" ? 500 : 10);
+      single.MakeDeposit(user, asset, amount);
+      sharded.MakeDeposit(user, asset, amount);
+    } else if (kind < 4) {
+      const std::string &asset = (kind == 2) ? "USD" : coin;
+      const int amount = 1 + Random(seed, asset == "USD" ? 2000 : 20);
+      single_ok.push_back(single.MakeWithdrawal(user, asset, amount));
+      sharded_ok.emplace_back();
+      sharded.MakeWithdrawal(user, asset, amount, &sharded_ok.back());
+      usd_refused += asset == "USD" && !single_ok.back();
+    } else if (kind < 5 && !single_ids.empty()) {
+      // The router only learns sharded ids once they are flushed.
+      sharded.Flush();
+      const std::size_t j = Random(seed, single_ids.size());
+      single_ok.push_back(single.CancelOrder(single_ids[j]));
+      sharded_ok.emplace_back();
+      sharded.CancelOrder(sharded_ids[j], &sharded_ok.back());
+    } else {
+      const Order order(user, Random(seed, 2) ? "Sell" : "Buy", coin,
+                        1 + Random(seed, 10), 90 + Random(seed, 20));
+      single_ids.push_back(single.AddOrder(order));
+      sharded_ids.emplace_back();
+      sharded.AddOrder(order, &sharded_ids.back());
+    }
+  }
+  sharded.Flush();
+  bool same_sharded = usd_refused > 0 &&
+                      std::equal(single_ok.begin(), single_ok.end(),
+                                 sharded_ok.begin(), sharded_ok.end());
+  for (std::size_t j = 0; j < single_ids.size(); ++j) {
+    same_sharded &= (single_ids[j] == kInvalidOrderId) ==
+                    (sharded_ids[j] == kInvalidOrderId);
+  }
+  std::vector<std::string> sharded_book;
+  for (std::size_t s = 0; s < sharded.ShardCount(); ++s) {
+    const Exchange &shard = sharded.ShardExchange(s);
+    const std::vector<std::string> orders = Book(shard);
+    sharded_book.insert(sharded_book.end(), orders.begin(), orders.end());
+    for (const std::string &coin : coins) {
+      const AssetId asset = shard.assets.Find(coin);
+      if (asset == SymbolTable::kNotFound) continue;
+      for (int u = 0; u < 6; ++u) {
+        const std::string user = "u" + std::to_string(u);
+        if (coins[u % 3] != coin) continue;
+        same_sharded &= shard.ledger.Balance(shard.users.Find(user), asset) ==
+                        single.ledger.Balance(single.users.Find(user),
+                                              single.assets.Find(coin));
+      }
+    }
+  }
+  std::sort(sharded_book.begin(), sharded_book.end());
+  for (int u = 0; u < 6; ++u) {
+    const std::string user = "u" + std::to_string(u);
+    same_sharded &= sharded.UsdBalance(user) ==
+                    single.ledger.Balance(single.users.Find(user),
+                                          Exchange::kUsd);
+  }
+  CHECK(same_sharded && sharded_book == Book(single));
+
   return 0;
 }
@@ -0,0 +1,118 @@
+#include "marketdata.hpp"
+
+MarketDataFeed::MarketDataFeed(Clock::duration snapshot_interval)
+    : snapshot_interval(snapshot_interval),
+      snapshot_at(Clock::now() + snapshot_interval) {}
+
+std::size_t MarketDataFeed::Subscribe(MarketDataSubscription subscription,
+                                      Clock::time_point now) {
+  subscribers.push_back({std::move(subscription), 0, now, {}});
+  SendSnapshots(subscribers.back());
+  return subscribers.size() - 1;
+}
+
+void MarketDataFeed::Apply(const ExecutionEvent &event, Clock::time_point now) {
+  if (event.type != EventType::BookUpdate) return;
+  if (event.asset >= books.size()) books.resize(event.asset + 1);
+  AssetDepth &depth = books[event.asset];
+  depth.seen = true;
+  std::map<Price, Qty> &levels =
+      (event.side == Side::Buy) ? depth.bids : depth.asks;
+  if (event.remaining) levels[event.price] = event.remaining;
+  else levels.erase(event.price);
+  ++updates;
+
+  const LevelKey level{event.asset, event.side, event.price};
+  for (Subscriber &subscriber : subscribers) {
+    if (subscriber.config.conflation == Clock::duration::zero()) {
+      Send(subscriber, level, event.remaining);
+      continue;
+    }
+    // The window opens with the first change held back.
+    if (subscriber.pending.empty()) {
+      subscriber.flush_at = now + subscriber.config.conflation;
+    }
+    subscriber.pending[level] = event.remaining;
+  }
+  Tick(now);
+}
+
+void MarketDataFeed::Tick(Clock::time_point now) {
+  if (snapshot_interval != Clock::duration::zero() && now >= snapshot_at) {
+    for (Subscriber &subscriber : subscribers) SendSnapshots(subscriber);
+    snapshot_at = now + snapshot_interval;
+  }
+  for (Subscriber &subscriber : subscribers) {
+    if (!subscriber.pending.empty() && now >= subscriber.flush_at) {
+      Flush(subscriber);
+    }
+  }
+}
+
+std::size_t MarketDataFeed::Pump(EventRing &ring, std::size_t reader) {
+  const Clock::time_point now = Clock::now();
+  std::size_t read = 0;
+  ExecutionEvent event;
+  while (ring.TryRead(reader, event)) {
+    Apply(event, now);
+    ++read;
+  }
+  Tick(now);
+  return read;
+}
+
+DepthSnapshot MarketDataFeed::Snapshot(AssetId asset) const {
+  DepthSnapshot snapshot{0, asset, {}, {}};
+  if (asset >= books.size()) return snapshot;
+  const AssetDepth &depth = books[asset];
+  snapshot.bids.reserve(depth.bids.size());
+  for (auto it = depth.bids.rbegin(); it != depth.bids.rend(); ++it) {
+    snapshot.bids.push_back({it->first, it->second});
+  }
+  snapshot.asks.reserve(depth.asks.size());
+  for (const auto &[price, quantity] : depth.asks) {
+    snapshot.asks.push_back({price, quantity});
+  }
+  return snapshot;
+}
+
+std::size_t MarketDataFeed::TopLevels(AssetId asset, Side side,
+                                      DepthLevel *out, std::size_t n) const {
+  if (asset >= books.size()) return 0;
+  std::size_t count = 0;
+  auto copy = [&](auto first, auto last) {
+    for (; first != last && count < n; ++first) {
+      out[count++] = {first->first, first->second};
+    }
+  };
+  const AssetDepth &depth = books[asset];
+  if (side == Side::Buy) copy(depth.bids.rbegin(), depth.bids.rend());
+  else copy(depth.asks.begin(), depth.asks.end());
+  return count;
+}
+
+void MarketDataFeed::Send(Subscriber &subscriber, const LevelKey &level,
+                          Qty quantity) {
+  const auto &[asset, side, price] = level;
+  const DepthUpdate update{++subscriber.sequence, asset, side, price,
+                           quantity};
+  if (subscriber.config.on_update) subscriber.config.on_update(update);
+}
+
+void MarketDataFeed::SendSnapshots(Subscriber &subscriber) {
+  // The snapshots supersede whatever was being conflated.
+  subscriber.pending.clear();
+  for (AssetId asset = 0; asset < books.size(); ++asset) {
+    if (!books[asset].seen) continue;
+    DepthSnapshot snapshot = Snapshot(asset);
+    snapshot.sequence = ++subscriber.sequence;
+    if (subscriber.config.on_snapshot) subscriber.config.on_snapshot(snapshot);
+  }
+}
+
+void MarketDataFeed::Flush(Subscriber &subscriber) {
+  for (const auto &[level, quantity] : subscriber.pending) {
+    Send(subscriber, level, quantity);
+  }
+  subscriber.pending.clear();
+}
@@ -0,0 +1,106 @@
+#pragma once
+// Level-2 market data. A MarketDataFeed follows the BookUpdate events of an
+// EventRing, keeps the aggregated size of every price level of every asset,
+// and sends each subscriber incremental (price, new size) updates along with
+// full depth snapshots: one when it subscribes, then one per asset every
+// snapshot interval. A subscriber with a conflation window gets at most one
+// update per level per window, carrying the level's latest size.
+//
+// Every message a subscriber receives carries the next number of its own
+// sequence, so a gap means something was lost and the book it holds should
+// be rebuilt from the next snapshot. A snapshot replaces the whole book of
+// its asset.
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "events.hpp"
+#include "utility.hpp"
+
+// New size of one price level; zero means the level is gone.
+struct DepthUpdate {
+  std::uint64_t sequence;
+  AssetId asset;
+  Side side;
+  Price price;
+  Qty quantity;
+};
+
+struct DepthLevel {
+  Price price;
+  Qty quantity;
+};
+
+// Every level of one asset, best price first on both sides.
+struct DepthSnapshot {
+  std::uint64_t sequence;
+  AssetId asset;
+  std::vector<DepthLevel> bids;
+  std::vector<DepthLevel> asks;
+};
+
+struct MarketDataSubscription {
+  // Zero sends every update as it happens.
+  std::chrono::steady_clock::duration conflation{};
+  std::function<void(const DepthUpdate &)> on_update;
+  std::function<void(const DepthSnapshot &)> on_snapshot;
+};
+
+class MarketDataFeed {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // A zero interval sends snapshots only when a subscriber joins.
+  explicit MarketDataFeed(Clock::duration snapshot_interval);
+
+  // Adds a subscriber and sends it a snapshot of every asset seen so far.
+  // Returns its index.
+  std::size_t Subscribe(MarketDataSubscription subscription,
+                        Clock::time_point now = Clock::now());
+
+  // Folds one engine event into the book and passes the change on to the
+  // subscribers. Events other than BookUpdate are ignored.
+  void Apply(const ExecutionEvent &event, Clock::time_point now);
+  // Sends conflated updates whose window has closed and snapshots that are
+  // due. Apply does this as well; call it when events are sparse.
+  void Tick(Clock::time_point now);
+  // Applies every event `reader` has waiting on `ring`, then ticks. Returns
+  // how many events were read.
+  std::size_t Pump(EventRing &ring, std::size_t reader);
+
+  DepthSnapshot Snapshot(AssetId asset) const;
+  // Copies the best `n` levels of one side into `out`, best first, and
+  // returns how many there were.
+  std::size_t TopLevels(AssetId asset, Side side, DepthLevel *out,
+                        std::size_t n) const;
+  // Number of level changes applied.
+  std::uint64_t Updates() const { return updates; }
+
+private:
+  struct AssetDepth {
+    std::map<Price, Qty> bids;
+    std::map<Price, Qty> asks;
+    bool seen = false; // has had a BookUpdate
+  };
+  // (asset, side, price)
+  using LevelKey = std::tuple<AssetId, Side, Price>;
+  struct Subscriber {
+    MarketDataSubscription config;
+    std::uint64_t sequence = 0;
+    Clock::time_point flush_at;
+    std::map<LevelKey, Qty> pending; // conflated, not yet sent
+  };
+
+  void Send(Subscriber &subscriber, const LevelKey &level, Qty quantity);
+  void SendSnapshots(Subscriber &subscriber);
+  void Flush(Subscriber &subscriber);
+
+  const Clock::duration snapshot_interval;
+  Clock::time_point snapshot_at;
+  std::vector<AssetDepth> books; // indexed by AssetId
+  std::vector<Subscriber> subscribers;
+  std::uint64_t updates = 0;
+};
@@ -0,0 +1,82 @@
+#include "orderbook.hpp"
+
+template <Side S>
+void BookSide<S>::UseLadder(Price low, Price tick, std::size_t count) {
+  dense = true;
+  ladder_low = low;
+  ladder_tick = tick;
+  occupancy.Resize(count);
+  ladder.resize((count + kLadderPage - 1) / kLadderPage);
+}
+
+template <Side S> void BookSide<S>::AddLadderPage(std::size_t page) {
+  std::vector<PriceLevel> &page_levels = ladder[page];
+  page_levels.reserve(kLadderPage);
+  for (std::size_t i = page * kLadderPage; i < (page + 1) * kLadderPage; ++i) {
+    page_levels.emplace_back(ladder_low + Price(i * ladder_tick.Raw()),
+                                levels.get_allocator());
+  }
+}
+
+template <Side S> PriceLevel *BookSide<S>::FindOrAddLevel(Price price) {
+  if (!dense) {
+    return &levels.try_emplace(price, price, levels.get_allocator())
+                .first->second;
+  }
+  const std::size_t index = (price - ladder_low).Raw() / ladder_tick.Raw();
+  const std::size_t page = index >> kLadderPageBits;
+  if (ladder[page].empty()) AddLadderPage(page);
+  PriceLevel &level = ladder[page][index & (kLadderPage - 1)];
+  if (level.queue.empty()) {
+    if (occupancy.Empty() || Better(index, best)) best = index;
+    occupancy.Set(index);
+  }
+  return &level;
+}
+
+template <Side S> void BookSide<S>::RemoveLevel(PriceLevel *level) {
+  if (!dense) {
+    levels.erase(level->price);
+    return;
+  }
+  const std::size_t index =
+      (level->price - ladder_low).Raw() / ladder_tick.Raw();
+  occupancy.Clear(index);
+  if (index != best || occupancy.Empty()) return;
+  // The next best level is the nearest occupied one on the worse side.
+  if constexpr (S == Side::Buy) best = occupancy.PrevAtOrBefore(index);
+  else best = occupancy.NextAtOrAfter(index);
+}
+
+template <Side S> void BookSide<S>::PopFront() {
+  PriceLevel *best_level = BestLevel();
+  best_level->quantity -= best_level->queue.front().order.amount;
+  best_level->queue.pop_front();
+  if (best_level->queue.empty()) RemoveLevel(best_level);
+}
+
+template <Side S>
+BookPosition BookSide<S>::Push(OrderId id, const BookOrder &order) {
+  PriceLevel *level = FindOrAddLevel(order.price);
+  level->quantity += order.amount;
+  return {level, level->queue.insert(level->queue.end(), {id, order})};
+}
+
+template <Side S> void BookSide<S>::Erase(BookPosition pos) {
+  pos.level->quantity -= pos.it->order.amount;
+  pos.level->queue.erase(pos.it);
+  if (pos.level->queue.empty()) RemoveLevel(pos.level);
+}
+
+template <Side S> void BookSide<S>::Reduce(BookPosition pos, Qty amount) {
+  pos.it->order.amount -= amount;
+  pos.level->quantity -= amount;
+}
+
+template <Side S> void BookSide<S>::ReduceFront(Qty amount) {
+  PriceLevel *best_level = BestLevel();
+  Reduce({best_level, best_level->queue.begin()}, amount);
+}
+
+template class BookSide<Side::Buy>;
+template class BookSide<Side::Sell>;
@@ -0,0 +1,213 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "pool.hpp"
+#include "utility.hpp"
+
+// An order resting in the book. IDs increase with arrival, so sorting by id
+// lists open orders in chronological order. Each order is also linked into
+// its owner's list of open orders (see UserOrderLists).
+struct RestingOrder {
+  OrderId id;
+  BookOrder order;
+  RestingOrder *prev_for_user = nullptr;
+  RestingOrder *next_for_user = nullptr;
+};
+
+// Orders at one price, oldest first, with their total amount kept up to date
+// on every change so a level's size never has to be summed. Queue and level
+// nodes come from the exchange's SlabPool.
+using OrderQueue = std::list<RestingOrder, PoolAllocator<RestingOrder>>;
+struct PriceLevel {
+  PriceLevel(Price price, const OrderQueue::allocator_type &allocator)
+      : queue(allocator), price(price) {}
+
+  OrderQueue queue;
+  Qty quantity = 0;
+  Price price;
+};
+using PriceLevels =
+    std::map<Price, PriceLevel, std::less<Price>,
+             PoolAllocator<std::pair<const Price, PriceLevel>>>;
+
+// Where an order sits: its level and its place in that level's queue. Both
+// stay valid until the order itself is removed.
+struct BookPosition {
+  PriceLevel *level = nullptr;
+  OrderQueue::iterator it = {};
+};
+
+// Resting interest at the best price of one side.
+struct Quote {
+  Price price = 0;
+  Qty quantity = 0;       // total amount at `price`
+  std::size_t orders = 0; // number of orders at `price`
+};
+
+// Best bid and best ask of one asset; either is empty when that side is.
+struct TopOfBook {
+  AssetId asset = 0;
+  std::optional<Quote> bid;
+  std::optional<Quote> ask;
+};
+
+// One side of an order book, holding orders on side S. Orders are grouped by
+// price level and queued first-in-first-out within a level, so the best order
+// is always the front of the best level.
+//
+// Levels live in a price-ordered map by default. A side for an asset with a
+// bounded price band can instead use a ladder: one level per tick of the
+// band, found by (price - low) / tick with no search. Ladder levels are built
+// a page at a time, when an order first rests in the page, so a wide band
+// only costs memory around the prices that trade. An occupancy bitmap over
+// the ladder finds the next best level when the best one empties, in a few
+// instructions however wide the gap.
+template <Side S> class BookSide {
+public:
+  explicit BookSide(SlabPool &pool)
+      : levels(PriceLevels::allocator_type(pool)) {}
+
+  // Switches to a ladder of `count` levels at low, low + tick, ... Side must
+  // be empty.
+  void UseLadder(Price low, Price tick, std::size_t count);
+
+  bool Empty() const { return dense ? occupancy.Empty() : levels.empty(); }
+
+  // Highest price for bids, lowest price for asks. Side must not be empty.
+  Price BestPrice() const { return BestLevel()->price; }
+
+  // Whether an incoming order on the other side at `price` trades with the
+  // best level of this side.
+  bool Crosses(Price price) const {
+    if (Empty()) return false;
+    if constexpr (S == Side::Buy) return BestPrice() >= price;
+    else return BestPrice() <= price;
+  }
+
+  // Best price with its total size and order count, or empty. O(1).
+  std::optional<Quote> Top() const {
+    if (Empty()) return std::nullopt;
+    const PriceLevel *best = BestLevel();
+    return Quote{best->price, best->quantity, best->queue.size()};
+  }
+
+  // Oldest order at the best price. Side must not be empty.
+  RestingOrder &Front() { return BestLevel()->queue.front(); }
+
+  void PopFront();
+  BookPosition Push(OrderId id, const BookOrder &order);
+  void Erase(BookPosition pos);
+  // Takes `amount` off the order at `pos`, which stays queued even at zero.
+  void Reduce(BookPosition pos, Qty amount);
+  void ReduceFront(Qty amount);
+
+  // Calls f(const PriceLevel &) for every level with orders, in no
+  // particular order.
+  template <typename F> void ForEachLevel(F f) const {
+    if (!dense) {
+      for (const auto &[price, level] : levels) f(level);
+    } else {
+      for (std::size_t i = occupancy.NextAtOrAfter(0);
+           i != OccupancyBitmap::kNone; i = occupancy.NextAtOrAfter(i + 1)) {
+        f(LadderLevel(i));
+      }
+    }
+  }
+
+private:
+  PriceLevel *BestLevel() {
+    return const_cast<PriceLevel *>(std::as_const(*this).BestLevel());
+  }
+  const PriceLevel *BestLevel() const {
+    if (dense) return &LadderLevel(best);
+    if constexpr (S == Side::Buy) return &std::prev(levels.end())->second;
+    else return &levels.begin()->second;
+  }
+  // Whether ladder index a is a better price than b for this side.
+  static bool Better(std::size_t a, std::size_t b) {
+    if constexpr (S == Side::Buy) return a > b;
+    else return a < b;
+  }
+
+  // Ladder level at index i, whose page must have been built.
+  const PriceLevel &LadderLevel(std::size_t i) const {
+    return ladder[i >> kLadderPageBits][i & (kLadderPage - 1)];
+  }
+  PriceLevel *FindOrAddLevel(Price price);
+  // Builds the levels of ladder page `page`.
+  void AddLadderPage(std::size_t page);
+  // Drops `level`, whose queue has just emptied.
+  void RemoveLevel(PriceLevel *level);
+
+  // Map mode.
+  PriceLevels levels;
+  // Ladder mode. Pages not yet built are empty.
+  static constexpr std::size_t kLadderPageBits = 10;
+  static constexpr std::size_t kLadderPage = std::size_t(1) << kLadderPageBits;
+  bool dense = false;
+  std::vector<std::vector<PriceLevel>> ladder;
+  Price ladder_low = 0;
+  Price ladder_tick = 1;
+  OccupancyBitmap occupancy; // ladder levels with orders
+  std::size_t best = 0;       // index of the best one, when any
+};
+
+struct OrderBook {
+  explicit OrderBook(SlabPool &pool) : bids(pool), asks(pool) {}
+
+  BookSide<Side::Buy> bids;
+  BookSide<Side::Sell> asks;
+
+  // The side orders on side S rest on.
+  template <Side S> BookSide<S> &Resting() {
+    if constexpr (S == Side::Buy) return bids;
+    else return asks;
+  }
+
+  void Erase(Side side, BookPosition pos) {
+    if (side == Side::Buy) bids.Erase(pos);
+    else asks.Erase(pos);
+  }
+
+  void Reduce(Side side, BookPosition pos, Qty amount) {
+    if (side == Side::Buy) bids.Reduce(pos, amount);
+    else asks.Reduce(pos, amount);
+  }
+
+  TopOfBook Top(AssetId asset) const { return {asset, bids.Top(), asks.Top()}; }
+};
+
+// Location of a resting order, kept in the exchange's order index.
+struct OrderHandle {
+  OrderBook *book = nullptr;
+  Side side = Side::Buy;
+  BookPosition pos = {};
+};
+
+// A fill as recorded for one side of a trade, chained to the same user's next
+// fill by index.
+struct FillRecord {
+  BookOrder order;
+  std::uint32_t next_for_user;
+};
+
+// Ends of one user's order lists. Open orders are linked through their
+// RestingOrder nodes, oldest first; fills are linked by index into the
+// exchange's filled orders, in the order they happened.
+struct UserOrderLists {
+  static constexpr std::uint32_t kNoFill = UINT32_MAX;
+
+  RestingOrder *open_head = nullptr;
+  RestingOrder *open_tail = nullptr;
+  std::uint32_t fill_head = kNoFill;
+  std::uint32_t fill_tail = kNoFill;
+  std::uint32_t fill_count = 0;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utility.hpp"
+
+// Open-addressing hash table from OrderId to a Value, used to locate resting
+// orders without scanning the book. Linear probing with backward-shift
+// deletion keeps lookups to a few adjacent slots and needs no tombstones.
+// Slots whose id is kInvalidOrderId are empty.
+template <typename Value> class OrderIndex {
+public:
+  OrderIndex() : slots(16) {}
+
+  std::size_t Size() const { return count; }
+
+  // Makes room for `entries` in total without growing.
+  void Reserve(std::size_t entries) {
+    std::size_t capacity = slots.size();
+    while (entries * 4 > capacity * 3) capacity *= 2;
+    if (capacity != slots.size()) Rehash(capacity);
+  }
+
+  Value *Find(OrderId id) {
+    if (id == kInvalidOrderId) return nullptr;
+    for (std::size_t i = Home(id);; i = Next(i)) {
+      if (slots[i].id == id) return &slots[i].value;
+      if (slots[i].id == kInvalidOrderId) return nullptr;
+    }
+  }
+
+  const Value *Find(OrderId id) const {
+    return const_cast<OrderIndex *>(this)->Find(id);
+  }
+
+  // Inserts or overwrites the entry for `id`.
+  void Insert(OrderId id, const Value &value) {
+    if ((count + 1) * 4 > slots.size() * 3) Grow();
+    std::size_t i = Home(id);
+    while (slots[i].id != kInvalidOrderId && slots[i].id != id) i = Next(i);
+    if (slots[i].id == kInvalidOrderId) ++count;
+    slots[i] = {id, value};
+  }
+
+  bool Erase(OrderId id) {
+    if (id == kInvalidOrderId) return false;
+    std::size_t i = Home(id);
+    while (slots[i].id != id) {
+      if (slots[i].id == kInvalidOrderId) return false;
+      i = Next(i);
+    }
+    // Shift later members of the probe run back so no gap breaks it.
+    for (std::size_t j = Next(i);; j = Next(j)) {
+      if (slots[j].id == kInvalidOrderId) break;
+      const std::size_t home = Home(slots[j].id);
+      if (((j - home) & Mask()) >= ((j - i) & Mask())) {
+        slots[i] = slots[j];
+        i = j;
+      }
+    }
+    slots[i] = {};
+    --count;
+    return true;
+  }
+
+private:
+  struct Slot {
+    OrderId id = kInvalidOrderId;
+    Value value = {};
+  };
+
+  std::size_t Mask() const { return slots.size() - 1; }
+  std::size_t Next(std::size_t i) const { return (i + 1) & Mask(); }
+
+  // Fibonacci hashing; ids are sequential so this spreads neighbours apart.
+  std::size_t Home(OrderId id) const {
+    return static_cast<std::size_t>((id * 0x9E3779B97F4A7C15ull) >> 32) &
+           Mask();
+  }
+
+  void Grow() { Rehash(slots.size() * 2); }
+
+  void Rehash(std::size_t capacity) {
+    std::vector<Slot> old(capacity);
+    old.swap(slots);
+    count = 0;
+    for (const Slot &s : old) {
+      if (s.id != kInvalidOrderId) Insert(s.id, s.value);
+    }
+  }
+
+  std::vector<Slot> slots;
+  std::size_t count = 0;
+};
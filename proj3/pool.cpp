@@ -0,0 +1,51 @@
+#include "pool.hpp"
+#include <new>
+
+AllocationCounters &AllocationCounters::operator+=(
+    const AllocationCounters &other) {
+  pool_allocations += other.pool_allocations;
+  pool_deallocations += other.pool_deallocations;
+  upstream_allocations += other.upstream_allocations;
+  upstream_bytes += other.upstream_bytes;
+  return *this;
+}
+
+SlabPool::~SlabPool() {
+  for (void *slab : slabs) ::operator delete(slab);
+}
+
+void *SlabPool::Upstream(std::size_t bytes) {
+  ++counters.upstream_allocations;
+  counters.upstream_bytes += bytes;
+  return ::operator new(bytes);
+}
+
+void *SlabPool::Allocate(std::size_t bytes) {
+  if (bytes > kMaxBlock) return Upstream(bytes);
+  ++counters.pool_allocations;
+  const std::size_t size_class = SizeClass(bytes);
+  if (FreeBlock *block = free_lists[size_class]) {
+    free_lists[size_class] = block->next;
+    return block;
+  }
+  const std::size_t block_bytes = (size_class + 1) * kAlignment;
+  if (static_cast<std::size_t>(slab_end - cursor) < block_bytes) {
+    // The old slab's tail is too small for this class and is left unused.
+    slabs.push_back(Upstream(kSlabBytes));
+    cursor = static_cast<char *>(slabs.back());
+    slab_end = cursor + kSlabBytes;
+  }
+  void *p = cursor;
+  cursor += block_bytes;
+  return p;
+}
+
+void SlabPool::Deallocate(void *p, std::size_t bytes) {
+  if (bytes > kMaxBlock) {
+    ::operator delete(p);
+    return;
+  }
+  ++counters.pool_deallocations;
+  FreeBlock *&head = free_lists[SizeClass(bytes)];
+  head = new (p) FreeBlock{head};
+}
@@ -0,0 +1,162 @@
+#pragma once
+// Engine-owned memory. The book's list and map nodes come from a SlabPool
+// through PoolAllocator, and fill and trade records are appended to
+// RecordArenas, so once the pool has warmed up, matching, resting and
+// cancelling orders never call the global allocator. AllocationCounters show
+// how often each still goes upstream.
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct AllocationCounters {
+  std::uint64_t pool_allocations = 0;     // blocks handed out by a pool
+  std::uint64_t pool_deallocations = 0;   // blocks given back to a pool
+  std::uint64_t upstream_allocations = 0; // calls to the global allocator
+  std::uint64_t upstream_bytes = 0;
+
+  AllocationCounters &operator+=(const AllocationCounters &other);
+};
+
+// Fixed-size blocks carved from 64 KiB slabs, with one free list per 16-byte
+// size class. Freed blocks are reused before any new slab is taken, and slabs
+// are only returned when the pool is destroyed. Requests above kMaxBlock go
+// straight to the global allocator.
+class SlabPool {
+public:
+  static constexpr std::size_t kAlignment = alignof(std::max_align_t);
+  static constexpr std::size_t kMaxBlock = 256;
+  static constexpr std::size_t kSlabBytes = 64 * 1024;
+
+  SlabPool() = default;
+  SlabPool(const SlabPool &) = delete;
+  SlabPool &operator=(const SlabPool &) = delete;
+  ~SlabPool();
+
+  void *Allocate(std::size_t bytes);
+  void Deallocate(void *p, std::size_t bytes);
+
+  const AllocationCounters &Counters() const { return counters; }
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  static std::size_t SizeClass(std::size_t bytes) {
+    return (bytes + kAlignment - 1) / kAlignment - 1;
+  }
+  void *Upstream(std::size_t bytes);
+
+  std::array<FreeBlock *, kMaxBlock / kAlignment> free_lists = {};
+  std::vector<void *> slabs;
+  char *cursor = nullptr; // unused tail of the newest slab
+  char *slab_end = nullptr;
+  AllocationCounters counters;
+};
+
+// Standard allocator over a SlabPool, for node-based containers. Containers
+// built with it must not outlive the pool.
+template <typename T> class PoolAllocator {
+public:
+  using value_type = T;
+  static_assert(alignof(T) <= SlabPool::kAlignment, "over-aligned type");
+
+  explicit PoolAllocator(SlabPool &pool) : pool(&pool) {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &other) : pool(other.pool) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(pool->Allocate(n * sizeof(T)));
+  }
+  void deallocate(T *p, std::size_t n) { pool->Deallocate(p, n * sizeof(T)); }
+
+  template <typename U> bool operator==(const PoolAllocator<U> &other) const {
+    return pool == other.pool;
+  }
+  template <typename U> bool operator!=(const PoolAllocator<U> &other) const {
+    return pool != other.pool;
+  }
+
+private:
+  template <typename U> friend class PoolAllocator;
+  SlabPool *pool;
+};
+
+// Append-only record log stored in fixed chunks. Unlike a vector it never
+// moves what it holds, so growing costs one allocation per kChunkRecords
+// records with no copying, and Reserve() can take those allocations up front.
+template <typename T> class RecordArena {
+public:
+  static constexpr std::size_t kChunkRecords = 4096;
+  static_assert(std::is_trivially_copyable<T>::value, "records are PODs");
+
+  std::size_t Size() const { return size; }
+  bool Empty() const { return size == 0; }
+
+  T &operator[](std::size_t i) {
+    return chunks[i / kChunkRecords][i % kChunkRecords];
+  }
+  const T &operator[](std::size_t i) const {
+    return chunks[i / kChunkRecords][i % kChunkRecords];
+  }
+
+  void Append(const T &record) {
+    if (size == chunks.size() * kChunkRecords) AddChunk();
+    (*this)[size++] = record;
+  }
+
+  void Append(const T *records, std::size_t count) {
+    Reserve(size + count);
+    while (count) {
+      const std::size_t offset = size % kChunkRecords;
+      const std::size_t n = std::min(count, kChunkRecords - offset);
+      std::copy_n(records, n, &chunks[size / kChunkRecords][offset]);
+      records += n;
+      count -= n;
+      size += n;
+    }
+  }
+
+  // Calls f(records, count) for each chunk in order.
+  template <typename F> void ForEachChunk(F f) const {
+    for (std::size_t first = 0; first < size; first += kChunkRecords) {
+      f(chunks[first / kChunkRecords].get(),
+        std::min(kChunkRecords, size - first));
+    }
+  }
+
+  // Makes room for `records` in total without further allocation.
+  void Reserve(std::size_t records) {
+    const std::size_t needed = (records + kChunkRecords - 1) / kChunkRecords;
+    if (needed > chunks.capacity()) GrowChunkList(needed);
+    while (chunks.size() * kChunkRecords < records) AddChunk();
+  }
+
+  const AllocationCounters &Counters() const { return counters; }
+
+private:
+  void AddChunk() {
+    if (chunks.size() == chunks.capacity()) {
+      GrowChunkList(std::max<std::size_t>(16, 2 * chunks.size()));
+    }
+    chunks.emplace_back(new T[kChunkRecords]);
+    ++counters.upstream_allocations;
+    counters.upstream_bytes += kChunkRecords * sizeof(T);
+  }
+
+  // The chunk list comes from the global allocator too, so its growth is
+  // counted along with the chunks.
+  void GrowChunkList(std::size_t capacity) {
+    chunks.reserve(capacity);
+    ++counters.upstream_allocations;
+    counters.upstream_bytes += capacity * sizeof(chunks[0]);
+  }
+
+  std::vector<std::unique_ptr<T[]>> chunks;
+  std::size_t size = 0;
+  AllocationCounters counters;
+};
@@ -0,0 +1,27 @@
+#include "ring.hpp"
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const char *WaitStrategyName(WaitStrategy strategy) {
+  switch (strategy) {
+  case WaitStrategy::Spin:
+    return "spin";
+  case WaitStrategy::Yield:
+    return "yield";
+  case WaitStrategy::Futex:
+    return "futex";
+  }
+  return "?";
+}
+
+void WakeSignal::Sleep(std::uint32_t seen) {
+  ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&epoch),
+            FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+}
+
+void WakeSignal::Wake() {
+  ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&epoch),
+            FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
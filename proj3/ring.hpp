@@ -0,0 +1,198 @@
+#pragma once
+// Bounded lock-free rings for passing fixed-size messages between threads,
+// and the wait strategies their users block with.
+//
+// SpscRing has one producer and one consumer: each side owns one index and
+// keeps a cached copy of the other's, so it only reads the shared one when
+// the ring looks full or empty. MpscRing takes any number of producers and
+// one consumer; producers claim slots with a CAS on the tail and publish
+// them through a per-slot sequence number (Vyukov's bounded queue). Indices
+// and slots are padded to cache lines so the two sides never share one.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+constexpr std::size_t kCacheLine = 64;
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+template <typename T> class SpscRing {
+public:
+  static_assert(std::is_trivially_copyable<T>::value, "messages are PODs");
+
+  // `capacity` must be a power of two.
+  explicit SpscRing(std::size_t capacity)
+      : mask(capacity - 1), slots(new T[capacity]) {}
+
+  bool TryPush(const T &item) {
+    const std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - cached_head > mask) {
+      cached_head = head.load(std::memory_order_acquire);
+      if (t - cached_head > mask) return false;
+    }
+    slots[t & mask] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T &item) {
+    const std::size_t h = head.load(std::memory_order_relaxed);
+    if (h == cached_tail) {
+      cached_tail = tail.load(std::memory_order_acquire);
+      if (h == cached_tail) return false;
+    }
+    item = slots[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Exact only on the consumer's thread.
+  bool Empty() const {
+    return head.load(std::memory_order_relaxed) ==
+           tail.load(std::memory_order_acquire);
+  }
+
+private:
+  // Consumer side.
+  alignas(kCacheLine) std::atomic<std::size_t> head{0};
+  std::size_t cached_tail = 0;
+  // Producer side.
+  alignas(kCacheLine) std::atomic<std::size_t> tail{0};
+  std::size_t cached_head = 0;
+
+  alignas(kCacheLine) const std::size_t mask;
+  const std::unique_ptr<T[]> slots;
+};
+
+template <typename T> class MpscRing {
+public:
+  static_assert(std::is_trivially_copyable<T>::value, "messages are PODs");
+
+  // `capacity` must be a power of two.
+  explicit MpscRing(std::size_t capacity)
+      : mask(capacity - 1), slots(new Slot[capacity]) {
+    for (std::size_t i = 0; i < capacity; ++i) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool TryPush(const T &item) {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots[t & mask];
+      const std::size_t sequence =
+          slot->sequence.load(std::memory_order_acquire);
+      const std::intptr_t lag = static_cast<std::intptr_t>(sequence - t);
+      if (lag == 0) {
+        if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lag < 0) {
+        return false; // the consumer has not freed this slot yet
+      } else {
+        t = tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot->item = item;
+    slot->sequence.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T &item) {
+    Slot &slot = slots[head & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+      return false;
+    }
+    item = slot.item;
+    slot.sequence.store(head + mask + 1, std::memory_order_release);
+    ++head;
+    return true;
+  }
+
+  // Only on the consumer's thread.
+  bool Empty() const {
+    return slots[head & mask].sequence.load(std::memory_order_acquire) !=
+           head + 1;
+  }
+
+private:
+  struct alignas(kCacheLine) Slot {
+    std::atomic<std::size_t> sequence;
+    T item;
+  };
+
+  alignas(kCacheLine) std::atomic<std::size_t> tail{0};
+  alignas(kCacheLine) std::size_t head = 0; // consumer only
+  const std::size_t mask;
+  const std::unique_ptr<Slot[]> slots;
+};
+
+// How a thread waits for a ring to become ready.
+enum class WaitStrategy {
+  Spin,  // busy-poll with a pause hint; lowest latency, burns a core
+  Yield, // poll, yielding the CPU between attempts
+  Futex, // poll briefly, then sleep in the kernel until signalled
+};
+
+const char *WaitStrategyName(WaitStrategy strategy);
+
+// Lets a waiting thread sleep under WaitStrategy::Futex. Waiters call
+// WaitUntil; the other side calls Notify after every change that could make
+// a waiter ready, which costs one atomic increment, plus a wake-up syscall
+// only when someone is asleep. Under Spin and Yield, Notify does nothing.
+class WakeSignal {
+public:
+  explicit WakeSignal(WaitStrategy strategy) : strategy(strategy) {}
+
+  // Returns once `ready()` is true. `ready` may have side effects, such as
+  // a TryPush, and is retried until it succeeds.
+  template <typename Ready> void WaitUntil(Ready ready) {
+    for (int attempt = 0; !ready(); ++attempt) {
+      if (strategy == WaitStrategy::Yield) {
+        std::this_thread::yield();
+      } else if (strategy == WaitStrategy::Spin ||
+                 attempt < kSpinsBeforeSleep) {
+        CpuRelax();
+      } else if (Park(ready)) {
+        return;
+      }
+    }
+  }
+
+  void Notify() {
+    if (strategy != WaitStrategy::Futex) return;
+    epoch.fetch_add(1);
+    if (sleepers.load()) Wake();
+  }
+
+private:
+  static constexpr int kSpinsBeforeSleep = 256;
+
+  // Sleeps until notified unless `ready()` turns true first; returns
+  // whether it did. The sleep is announced before that last check, so a
+  // Notify after the check either sees the sleeper or moves the epoch on,
+  // and the kernel then refuses to sleep on the stale value.
+  template <typename Ready> bool Park(Ready &ready) {
+    sleepers.fetch_add(1);
+    const std::uint32_t seen = epoch.load();
+    const bool now_ready = ready();
+    if (!now_ready) Sleep(seen);
+    sleepers.fetch_sub(1);
+    return now_ready;
+  }
+
+  void Sleep(std::uint32_t seen);
+  void Wake();
+
+  const WaitStrategy strategy;
+  alignas(kCacheLine) std::atomic<std::uint32_t> epoch{0};
+  std::atomic<std::uint32_t> sleepers{0};
+};
@@ -0,0 +1,293 @@
+#include "sharded.hpp"
+
+namespace {
+const std::string kUsdName = "USD";
+} // namespace
+
+void UsdAccounts::Open(std::uint32_t user) {
+  std::unique_ptr<std::atomic<std::int64_t>[]> &chunk =
+      chunks.at(user >> kChunkBits);
+  if (!chunk) {
+    chunk.reset(new std::atomic<std::int64_t>[std::size_t(1) << kChunkBits]);
+    for (std::size_t i = 0; i < (std::size_t(1) << kChunkBits); ++i) {
+      chunk[i].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+bool UsdAccounts::Debit(std::uint32_t user, std::int64_t amount) {
+  std::atomic<std::int64_t> &balance = Slot(user);
+  std::int64_t current = balance.load(std::memory_order_relaxed);
+  do {
+    if (current < amount) return false;
+  } while (!balance.compare_exchange_weak(current, current - amount,
+                                          std::memory_order_relaxed));
+  return true;
+}
+
+ShardedExchange::ShardedExchange(std::size_t shard_count) {
+  for (std::size_t i = 0; i < shard_count; ++i) {
+    shards.push_back(std::make_unique<Shard>());
+    Shard &shard = *shards.back();
+    shard.index = i;
+    shard.exchange.keep_history = false;
+    shard.exchange.paid_sellers = &shard.paid_sellers;
+  }
+  for (const std::unique_ptr<Shard> &shard : shards) {
+    shard->thread = std::thread(&ShardedExchange::Run, this, std::ref(*shard));
+  }
+}
+
+ShardedExchange::~ShardedExchange() {
+  for (const std::unique_ptr<Shard> &shard : shards) {
+    Hand(*shard);
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      shard->stopping = true;
+    }
+    shard->work.notify_one();
+  }
+  for (const std::unique_ptr<Shard> &shard : shards) shard->thread.join();
+}
+
+std::uint32_t ShardedExchange::UserSlot(const std::string &username) {
+  const std::uint32_t user = users.Intern(username);
+  if (user == user_names.size()) {
+    user_names.push_back(username);
+    usd.Open(user);
+  }
+  return user;
+}
+
+std::uint32_t ShardedExchange::AssetSlot(const std::string &asset) {
+  const std::uint32_t id = assets.Intern(asset);
+  if (id == asset_names.size()) {
+    asset_names.push_back(asset);
+    asset_shards.push_back(next_shard);
+    next_shard = (next_shard + 1) % shards.size();
+  }
+  return id;
+}
+
+ShardedExchange::Command
+ShardedExchange::MakeCommand(Command::Type type, const std::string &username,
+                             const std::string &asset) {
+  Command command = {};
+  command.type = type;
+  command.user = UserSlot(username);
+  command.asset = AssetSlot(asset);
+  command.user_name = &user_names[command.user];
+  command.asset_name = &asset_names[command.asset];
+  return command;
+}
+
+void ShardedExchange::Submit(std::size_t index, const Command &command) {
+  Shard &shard = *shards[index];
+  shard.outbox.push_back(command);
+  if (shard.outbox.size() >= kSubmitBatch) Hand(shard);
+}
+
+void ShardedExchange::Hand(Shard &shard) {
+  if (shard.outbox.empty()) return;
+  bool was_empty;
+  {
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    shard.space.wait(lock, [&] { return shard.pending.size() < kMaxPending; });
+    was_empty = shard.pending.empty();
+    shard.pending.insert(shard.pending.end(), shard.outbox.begin(),
+                         shard.outbox.end());
+    shard.queued += shard.outbox.size();
+  }
+  shard.outbox.clear();
+  if (was_empty) shard.work.notify_one();
+}
+
+void ShardedExchange::MakeDeposit(const std::string &username,
+                                  const std::string &asset,
+                                  std::int64_t amount) {
+  if (asset == kUsdName) {
+    const std::uint32_t user = UserSlot(username);
+    Flush();
+    usd.Credit(user, amount);
+    return;
+  }
+  Command command = MakeCommand(Command::Type::Deposit, username, asset);
+  command.amount = amount;
+  Submit(asset_shards[command.asset], command);
+}
+
+void ShardedExchange::MakeWithdrawal(const std::string &username,
+                                     const std::string &asset,
+                                     std::int64_t amount, bool *withdrawn) {
+  if (asset == kUsdName) {
+    const std::uint32_t user = UserSlot(username);
+    Flush();
+    const bool ok = usd.Debit(user, amount);
+    if (withdrawn) *withdrawn = ok;
+    return;
+  }
+  Command command = MakeCommand(Command::Type::Withdraw, username, asset);
+  command.amount = amount;
+  command.result = withdrawn;
+  Submit(asset_shards[command.asset], command);
+}
+
+void ShardedExchange::AddOrder(const Order &order, OrderId *id) {
+  if (order.asset == kUsdName) {
+    if (id) *id = kInvalidOrderId;
+    return;
+  }
+  Command command =
+      MakeCommand(Command::Type::AddOrder, order.username, order.asset);
+  command.side = ParseSide(order.side);
+  command.amount = order.amount;
+  command.price = order.price;
+  command.result = id;
+  Submit(asset_shards[command.asset], command);
+}
+
+// Ids are the shard's own id times the shard count plus the shard index, so
+// the owning shard can be read off the id.
+void ShardedExchange::CancelOrder(OrderId id, bool *cancelled) {
+  if (id == kInvalidOrderId) {
+    if (cancelled) *cancelled = false;
+    return;
+  }
+  Command command = {};
+  command.type = Command::Type::Cancel;
+  command.id = id / shards.size();
+  command.result = cancelled;
+  Submit(id % shards.size(), command);
+}
+
+void ShardedExchange::Flush() {
+  for (const std::unique_ptr<Shard> &shard : shards) Hand(*shard);
+  for (const std::unique_ptr<Shard> &shard : shards) {
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    shard->idle.wait(lock, [&] { return shard->applied == shard->queued; });
+  }
+}
+
+bool ShardedExchange::SetQuoteScale(int decimals) {
+  Flush();
+  bool ok = true;
+  for (const std::unique_ptr<Shard> &shard : shards) {
+    ok &= shard->exchange.SetQuoteScale(decimals);
+  }
+  return ok;
+}
+
+bool ShardedExchange::ListAsset(const AssetSpec &spec) {
+  if (assets.Find(spec.symbol) != SymbolTable::kNotFound) return false;
+  Flush();
+  Shard &shard = *shards[next_shard];
+  if (!shard.exchange.ListAsset(spec)) return false;
+  AssetSlot(spec.symbol);
+  return true;
+}
+
+std::int64_t ShardedExchange::UsdBalance(const std::string &username) const {
+  const std::uint32_t user = users.Find(username);
+  return (user == SymbolTable::kNotFound) ? 0 : usd.Balance(user);
+}
+
+void ShardedExchange::Run(Shard &shard) {
+  std::vector<Command> batch;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(shard.mutex);
+      shard.work.wait(lock,
+                      [&] { return !shard.pending.empty() || shard.stopping; });
+      if (shard.pending.empty()) return;
+      batch.swap(shard.pending);
+    }
+    shard.space.notify_one();
+    for (const Command &command : batch) Apply(shard, command);
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.applied += batch.size();
+    }
+    shard.idle.notify_all();
+    batch.clear();
+  }
+}
+
+UserId ShardedExchange::LocalUser(Shard &shard, const Command &command) {
+  if (command.user >= shard.local_users.size()) {
+    shard.local_users.resize(command.user + 1, SymbolTable::kNotFound);
+  }
+  UserId &user = shard.local_users[command.user];
+  if (user == SymbolTable::kNotFound) {
+    user = shard.exchange.users.Intern(*command.user_name);
+    if (user >= shard.usd_slot.size()) shard.usd_slot.resize(user + 1);
+    shard.usd_slot[user] = command.user;
+  }
+  return user;
+}
+
+AssetId ShardedExchange::LocalAsset(Shard &shard, const Command &command) {
+  if (command.asset >= shard.local_assets.size()) {
+    shard.local_assets.resize(command.asset + 1, SymbolTable::kNotFound);
+  }
+  AssetId &asset = shard.local_assets[command.asset];
+  if (asset == SymbolTable::kNotFound) {
+    asset = shard.exchange.InternAsset(*command.asset_name);
+  }
+  return asset;
+}
+
+void ShardedExchange::Sweep(Shard &shard, UserId user) {
+  Ledger &ledger = shard.exchange.ledger;
+  const std::int64_t free = ledger.Balance(user, Exchange::kUsd);
+  if (free > 0 && ledger.Debit(user, Exchange::kUsd, free)) {
+    usd.Credit(shard.usd_slot[user], free);
+  }
+}
+
+void ShardedExchange::Apply(Shard &shard, const Command &command) {
+  Exchange &e = shard.exchange;
+  switch (command.type) {
+  case Command::Type::Deposit:
+    e.MakeDeposit(LocalUser(shard, command), LocalAsset(shard, command),
+                  command.amount.Raw());
+    break;
+  case Command::Type::Withdraw: {
+    const bool ok =
+        e.MakeWithdrawal(LocalUser(shard, command),
+                         LocalAsset(shard, command), command.amount.Raw());
+    if (command.result) *static_cast<bool *>(command.result) = ok;
+    break;
+  }
+  case Command::Type::AddOrder: {
+    const UserId user = LocalUser(shard, command);
+    const BookOrder order = {user, command.side, LocalAsset(shard, command),
+                             command.amount, command.price};
+    e.ledger.OpenAccount(user);
+    // Pull a buy's reservation; if the shared balance is short, let the
+    // exchange reject the order for lack of funds.
+    std::int64_t reserve;
+    if (order.side == Side::Buy && e.ReservedAmount(order, reserve) &&
+        usd.Debit(command.user, reserve)) {
+      e.ledger.Credit(user, Exchange::kUsd, reserve);
+    }
+    shard.paid_sellers.clear();
+    const OrderId id = e.AddOrder(order);
+    if (command.result) {
+      *static_cast<OrderId *>(command.result) =
+          id ? id * shards.size() + shard.index : kInvalidOrderId;
+    }
+    // Sellers, taker and makers alike, were paid USD here.
+    Sweep(shard, user);
+    for (UserId seller : shard.paid_sellers) Sweep(shard, seller);
+    break;
+  }
+  case Command::Type::Cancel: {
+    const OrderHandle *handle = e.order_index.Find(command.id);
+    const UserId owner = handle ? handle->pos.it->order.user : 0;
+    const bool ok = e.CancelOrder(command.id);
+    if (ok) Sweep(shard, owner);
+    if (command.result) *static_cast<bool *>(command.result) = ok;
+    break;
+  }
+  }
+}
@@ -0,0 +1,171 @@
+#pragma once
+// Matching spread over threads by asset. Each shard is a thread that owns an
+// Exchange holding the books and non-USD balances of its group of assets;
+// assets are dealt to shards round-robin as they first appear. Books of
+// different assets never interact, so shards only share USD.
+//
+// USD lives in UsdAccounts, one atomic balance per user, outside every
+// shard. Between commands a shard holds no free USD of its own: before a buy
+// it pulls the order's reservation from the shared balance (failing the
+// order if it is short), and after every command it sweeps whatever USD its
+// exchange freed (sale proceeds, cancelled or rejected reservations) back.
+// USD reserved by resting buys stays with their shard until they fill or
+// are cancelled.
+//
+// So a sharded exchange gives the results of a single Exchange fed the same
+// commands as long as no user's USD is wanted by two shards at once. USD
+// deposits and withdrawals are barriers: they wait for every queued command
+// (see Flush) and so see exactly what those left. But between barriers a
+// user's buys in assets on different shards draw on the shared balance in
+// whatever order the shards get to them, and one shard's sale proceeds
+// reach the others only once swept; with funds too tight for all of them,
+// which buys fail is up to the schedule.
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "exchange.hpp"
+
+// USD balances shared by every shard. Slots never move once opened, so
+// shards may use any slot opened before the command that names it was
+// queued.
+class UsdAccounts {
+public:
+  UsdAccounts() : chunks(kMaxChunks) {}
+
+  // Called by the router only.
+  void Open(std::uint32_t user);
+  std::int64_t Balance(std::uint32_t user) const {
+    return Slot(user).load(std::memory_order_relaxed);
+  }
+  void Credit(std::uint32_t user, std::int64_t amount) {
+    Slot(user).fetch_add(amount, std::memory_order_relaxed);
+  }
+  bool Debit(std::uint32_t user, std::int64_t amount);
+
+private:
+  static constexpr std::uint32_t kChunkBits = 16;
+  static constexpr std::size_t kMaxChunks = std::size_t(1) << 16;
+
+  std::atomic<std::int64_t> &Slot(std::uint32_t user) const {
+    return chunks[user >> kChunkBits][user & ((1u << kChunkBits) - 1)];
+  }
+
+  std::vector<std::unique_ptr<std::atomic<std::int64_t>[]>> chunks;
+};
+
+class ShardedExchange {
+public:
+  explicit ShardedExchange(std::size_t shard_count);
+  ShardedExchange(const ShardedExchange &) = delete;
+  ShardedExchange &operator=(const ShardedExchange &) = delete;
+  // Finishes queued commands, then stops the shards.
+  ~ShardedExchange();
+
+  // Commands must all come from one thread, the router. They are queued to
+  // the owning shard, handed over kSubmitBatch at a time, and applied in
+  // submission order per asset; a result pointer, if given, is written by
+  // the time Flush() returns. Order ids are unique across shards. USD
+  // deposits and withdrawals Flush() first and are applied before they
+  // return.
+  void MakeDeposit(const std::string &username, const std::string &asset,
+                   std::int64_t amount);
+  void MakeWithdrawal(const std::string &username, const std::string &asset,
+                      std::int64_t amount, bool *withdrawn = nullptr);
+  void AddOrder(const Order &order, OrderId *id = nullptr);
+  void CancelOrder(OrderId id, bool *cancelled = nullptr);
+  // Hands over every queued command and waits until all are applied.
+  void Flush();
+
+  // Configuration waits for the shards to go idle first. The quote scale
+  // must be set before any asset appears.
+  bool SetQuoteScale(int decimals);
+  bool ListAsset(const AssetSpec &spec);
+
+  // Free USD, excluding reservations of resting buys. Exact once flushed.
+  std::int64_t UsdBalance(const std::string &username) const;
+  std::size_t ShardCount() const { return shards.size(); }
+  // A shard's exchange; only safe to read after Flush(). Shards keep no
+  // fill or trade history.
+  const Exchange &ShardExchange(std::size_t shard) const {
+    return shards[shard]->exchange;
+  }
+
+private:
+  // Names travel as the router's ids. A shard interns a name into its own
+  // exchange the first time it sees the id, reading it through the pointer;
+  // the router never changes or moves a name once stored.
+  struct Command {
+    enum class Type : std::uint8_t { Deposit, Withdraw, AddOrder, Cancel };
+    Type type;
+    Side side;
+    std::uint32_t user;  // UsdAccounts slot
+    std::uint32_t asset; // router's asset id
+    Qty amount;
+    Price price;
+    OrderId id;   // Cancel: the shard's own id
+    void *result; // bool * or OrderId *, or nullptr
+    const std::string *user_name;
+    const std::string *asset_name;
+  };
+  static_assert(std::is_trivially_copyable<Command>::value,
+                "commands are copied into the shard queues");
+
+  struct Shard {
+    std::size_t index = 0;
+    Exchange exchange;
+    std::vector<UserId> local_users = {};   // by UsdAccounts slot
+    std::vector<AssetId> local_assets = {}; // by router asset id
+    std::vector<std::uint32_t> usd_slot = {}; // by the exchange's UserId
+    std::vector<UserId> paid_sellers = {};    // makers paid by one command
+    std::vector<Command> outbox = {};         // router only: not handed over
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable work;  // commands queued or stopping
+    std::condition_variable idle;  // applied caught up with queued
+    std::condition_variable space; // room in pending
+    std::vector<Command> pending = {};
+    std::uint64_t queued = 0;
+    std::uint64_t applied = 0;
+    bool stopping = false;
+  };
+
+  // Commands a shard may have waiting before the router blocks.
+  static constexpr std::size_t kMaxPending = 4096;
+  // Commands the router collects for a shard before taking its lock.
+  static constexpr std::size_t kSubmitBatch = 64;
+
+  std::uint32_t UserSlot(const std::string &username);
+  // Router id of `asset`, assigning it a shard if it is new.
+  std::uint32_t AssetSlot(const std::string &asset);
+  // A command from `username` about `asset`.
+  Command MakeCommand(Command::Type type, const std::string &username,
+                      const std::string &asset);
+  void Submit(std::size_t shard, const Command &command);
+  // Moves the shard's outbox to its queue.
+  void Hand(Shard &shard);
+  void Run(Shard &shard);
+  void Apply(Shard &shard, const Command &command);
+  UserId LocalUser(Shard &shard, const Command &command);
+  AssetId LocalAsset(Shard &shard, const Command &command);
+  // Moves `user`'s free USD in `shard` back to UsdAccounts.
+  void Sweep(Shard &shard, UserId user);
+
+  UsdAccounts usd;
+  // Router only; the deques hold the names commands point to.
+  SymbolTable users = {}; // UsdAccounts slots
+  std::deque<std::string> user_names = {};
+  SymbolTable assets = {};
+  std::deque<std::string> asset_names = {};
+  std::vector<std::size_t> asset_shards = {}; // by router asset id
+  std::size_t next_shard = 0;
+  std::vector<std::unique_ptr<Shard>> shards = {};
+};
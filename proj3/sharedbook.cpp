@@ -0,0 +1,230 @@
+#include "sharedbook.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kMagic[4] = {'X', 'S', 'M', '1'};
+
+std::size_t RegionSize(std::size_t assets) {
+  return sizeof(sharedbook::Asset) * (assets + 1);
+}
+
+// The header takes the first slot so every asset block stays line-aligned.
+sharedbook::Asset *AssetBlocks(void *region) {
+  return static_cast<sharedbook::Asset *>(region) + 1;
+}
+
+// Seqlock writer side.
+void BeginWrite(std::atomic<std::uint64_t> &sequence) {
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void EndWrite(std::atomic<std::uint64_t> &sequence) {
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+}
+
+// Seqlock reader side: calls read() until it ran with no write under way.
+template <typename F>
+void ReadConsistent(const std::atomic<std::uint64_t> &sequence, F read) {
+  for (;;) {
+    const std::uint64_t before = sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      CpuRelax();
+      continue;
+    }
+    read();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence.load(std::memory_order_relaxed) == before) return;
+  }
+}
+
+void Store(sharedbook::Word &word, std::int64_t value) {
+  word.store(value, std::memory_order_relaxed);
+}
+
+std::int64_t Load(const sharedbook::Word &word) {
+  return word.load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+SharedBookWriter::~SharedBookWriter() {
+  if (!region) return;
+  ::munmap(region, size);
+  ::shm_unlink(name.c_str());
+}
+
+bool SharedBookWriter::Create(const std::string &name, std::size_t assets) {
+  ::shm_unlink(name.c_str());
+  const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) return false;
+  const std::size_t bytes = RegionSize(assets);
+  void *p = MAP_FAILED;
+  if (::ftruncate(fd, bytes) == 0) {
+    p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    ::shm_unlink(name.c_str());
+    return false;
+  }
+  // A new object is zero-filled: every block starts empty at sequence 0.
+  this->name = name;
+  region = p;
+  size = bytes;
+  this->assets = AssetBlocks(p);
+  asset_count = assets;
+  changed.assign(assets, false);
+  changed_list.clear();
+  sharedbook::Header &header = *static_cast<sharedbook::Header *>(p);
+  header.assets = assets;
+  header.depth = kSharedDepth;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  return true;
+}
+
+void SharedBookWriter::SetName(AssetId asset, const std::string &name) {
+  char *slot = assets[asset].name;
+  const std::size_t length =
+      std::min(name.size(), sizeof(assets[asset].name) - 1);
+  std::memcpy(slot, name.data(), length);
+  slot[length] = '\0';
+}
+
+void SharedBookWriter::Follow(MarketDataFeed &feed) {
+  MarketDataSubscription subscription;
+  subscription.on_update = [this](const DepthUpdate &update) {
+    MarkChanged(update.asset);
+  };
+  subscription.on_snapshot = [this](const DepthSnapshot &snapshot) {
+    MarkChanged(snapshot.asset);
+  };
+  feed.Subscribe(std::move(subscription));
+}
+
+void SharedBookWriter::MarkChanged(AssetId asset) {
+  if (asset >= asset_count || changed[asset]) return;
+  changed[asset] = true;
+  changed_list.push_back(asset);
+}
+
+std::size_t SharedBookWriter::Publish(const MarketDataFeed &feed,
+                                      std::uint64_t stamp) {
+  for (AssetId asset : changed_list) {
+    Write(feed, asset, stamp);
+    changed[asset] = false;
+  }
+  const std::size_t written = changed_list.size();
+  changed_list.clear();
+  return written;
+}
+
+void SharedBookWriter::Write(const MarketDataFeed &feed, AssetId asset,
+                             std::uint64_t stamp) {
+  DepthLevel bids[kSharedDepth], asks[kSharedDepth];
+  const std::size_t bid_levels =
+      feed.TopLevels(asset, Side::Buy, bids, kSharedDepth);
+  const std::size_t ask_levels =
+      feed.TopLevels(asset, Side::Sell, asks, kSharedDepth);
+
+  sharedbook::Quote &quote = assets[asset].quote;
+  BeginWrite(quote.sequence);
+  Store(quote.stamp, stamp);
+  Store(quote.bid_price, bid_levels ? bids[0].price.Raw() : 0);
+  Store(quote.bid_quantity, bid_levels ? bids[0].quantity.Raw() : 0);
+  Store(quote.ask_price, ask_levels ? asks[0].price.Raw() : 0);
+  Store(quote.ask_quantity, ask_levels ? asks[0].quantity.Raw() : 0);
+  EndWrite(quote.sequence);
+
+  sharedbook::Depth &depth = assets[asset].depth;
+  BeginWrite(depth.sequence);
+  Store(depth.stamp, stamp);
+  Store(depth.bid_levels, bid_levels);
+  Store(depth.ask_levels, ask_levels);
+  for (std::size_t i = 0; i < bid_levels; ++i) {
+    Store(depth.bids[2 * i], bids[i].price.Raw());
+    Store(depth.bids[2 * i + 1], bids[i].quantity.Raw());
+  }
+  for (std::size_t i = 0; i < ask_levels; ++i) {
+    Store(depth.asks[2 * i], asks[i].price.Raw());
+    Store(depth.asks[2 * i + 1], asks[i].quantity.Raw());
+  }
+  EndWrite(depth.sequence);
+}
+
+SharedBookReader::~SharedBookReader() {
+  if (region) ::munmap(const_cast<void *>(region), size);
+}
+
+bool SharedBookReader::Open(const std::string &name) {
+  const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) return false;
+  struct stat st;
+  void *p = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 &&
+      static_cast<std::size_t>(st.st_size) >= RegionSize(0)) {
+    p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (p == MAP_FAILED) return false;
+  const sharedbook::Header &header = *static_cast<sharedbook::Header *>(p);
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.depth != kSharedDepth ||
+      RegionSize(header.assets) > static_cast<std::size_t>(st.st_size)) {
+    ::munmap(p, st.st_size);
+    return false;
+  }
+  region = p;
+  size = st.st_size;
+  assets = AssetBlocks(p);
+  asset_count = header.assets;
+  return true;
+}
+
+AssetId SharedBookReader::Find(const std::string &name) const {
+  for (AssetId asset = 0; asset < asset_count; ++asset) {
+    if (name == assets[asset].name) return asset;
+  }
+  return kNotFound;
+}
+
+BookQuote SharedBookReader::ReadQuote(AssetId asset) const {
+  const sharedbook::Quote &quote = assets[asset].quote;
+  BookQuote copy;
+  ReadConsistent(quote.sequence, [&] {
+    copy.stamp = Load(quote.stamp);
+    copy.bid_price = Load(quote.bid_price);
+    copy.bid_quantity = Load(quote.bid_quantity);
+    copy.ask_price = Load(quote.ask_price);
+    copy.ask_quantity = Load(quote.ask_quantity);
+  });
+  return copy;
+}
+
+void SharedBookReader::ReadDepth(AssetId asset, BookDepth &copy) const {
+  const sharedbook::Depth &depth = assets[asset].depth;
+  ReadConsistent(depth.sequence, [&] {
+    copy.stamp = Load(depth.stamp);
+    // Clamped so a torn count cannot run past the arrays; such a copy is
+    // discarded anyway.
+    copy.bid_levels = std::min<std::size_t>(Load(depth.bid_levels),
+                                            kSharedDepth);
+    copy.ask_levels = std::min<std::size_t>(Load(depth.ask_levels),
+                                            kSharedDepth);
+    for (std::size_t i = 0; i < copy.bid_levels; ++i) {
+      copy.bids[i] = {Load(depth.bids[2 * i]), Load(depth.bids[2 * i + 1])};
+    }
+    for (std::size_t i = 0; i < copy.ask_levels; ++i) {
+      copy.asks[i] = {Load(depth.asks[2 * i]), Load(depth.asks[2 * i + 1])};
+    }
+  });
+}
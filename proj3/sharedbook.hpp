@@ -0,0 +1,145 @@
+#pragma once
+// Best bid/offer and top-of-book depth in POSIX shared memory, for other
+// processes on the host (strategies, risk, UIs) that need the book without
+// a round trip through the matching thread. One writer fills the region
+// from a MarketDataFeed; any number of readers map it read-only and poll.
+//
+// Each asset has two seqlocked blocks: its quote (BBO) and its depth (the
+// best kSharedDepth levels a side). The writer makes a block's sequence odd,
+// stores the fields and makes it even again; a reader copies the fields
+// between two loads of the sequence and retries if they differ or are odd.
+// Readers never write to the region, so they cannot slow the writer or each
+// other, and a block a reader is not polling costs it nothing.
+//
+// Every publish also stores a stamp, a steady_clock (CLOCK_MONOTONIC) time
+// in nanoseconds supplied by the writer, so readers on the same host can
+// tell how old what they see is.
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "marketdata.hpp"
+#include "ring.hpp"
+
+// Levels kept per side in the depth block.
+constexpr std::size_t kSharedDepth = 8;
+
+struct BookQuote {
+  std::uint64_t stamp = 0;
+  Price bid_price; // sides with nothing resting have zero size
+  Qty bid_quantity;
+  Price ask_price;
+  Qty ask_quantity;
+};
+
+struct BookDepth {
+  std::uint64_t stamp = 0;
+  std::size_t bid_levels = 0;
+  std::size_t ask_levels = 0;
+  DepthLevel bids[kSharedDepth]; // best first
+  DepthLevel asks[kSharedDepth];
+};
+
+// Layout of the region. Every field is an atomic word, so the copies a
+// reader takes while the writer is mid-update are racy only in value, never
+// undefined; the sequence check throws those copies away.
+namespace sharedbook {
+
+using Word = std::atomic<std::int64_t>;
+static_assert(Word::is_always_lock_free, "shared across processes");
+
+struct Header {
+  char magic[4]; // "XSM1"
+  std::uint32_t assets;
+  std::uint32_t depth;
+};
+
+struct alignas(kCacheLine) Quote {
+  std::atomic<std::uint64_t> sequence;
+  Word stamp;
+  Word bid_price, bid_quantity;
+  Word ask_price, ask_quantity;
+};
+
+struct alignas(kCacheLine) Depth {
+  std::atomic<std::uint64_t> sequence;
+  Word stamp;
+  Word bid_levels, ask_levels;
+  Word bids[2 * kSharedDepth]; // price, quantity, price, ...
+  Word asks[2 * kSharedDepth];
+};
+
+struct alignas(kCacheLine) Asset {
+  char name[kCacheLine]; // set once, before the first publish
+  Quote quote;
+  Depth depth;
+};
+
+} // namespace sharedbook
+
+class SharedBookWriter {
+public:
+  SharedBookWriter() = default;
+  SharedBookWriter(const SharedBookWriter &) = delete;
+  SharedBookWriter &operator=(const SharedBookWriter &) = delete;
+  // Unmaps and unlinks the region; readers that have it mapped keep it.
+  ~SharedBookWriter();
+
+  // Creates (or replaces) the shared memory object `name` ("/exchange-book")
+  // with room for `assets` asset ids, all initially empty.
+  bool Create(const std::string &name, std::size_t assets);
+  // Names asset `asset` for SharedBookReader::Find. Names longer than 63
+  // characters are cut short.
+  void SetName(AssetId asset, const std::string &name);
+
+  // Subscribes to `feed` so that assets whose depth changes are published
+  // by the next Publish. Call before the feed sees any events.
+  void Follow(MarketDataFeed &feed);
+  // Writes the quote and depth of every asset changed since the last call,
+  // stamped with `stamp`. Returns how many assets were written.
+  std::size_t Publish(const MarketDataFeed &feed, std::uint64_t stamp);
+
+private:
+  void MarkChanged(AssetId asset);
+  void Write(const MarketDataFeed &feed, AssetId asset, std::uint64_t stamp);
+
+  std::string name;
+  void *region = nullptr;
+  std::size_t size = 0;
+  sharedbook::Asset *assets = nullptr;
+  std::size_t asset_count = 0;
+  std::vector<bool> changed; // indexed by AssetId
+  std::vector<AssetId> changed_list;
+};
+
+class SharedBookReader {
+public:
+  static constexpr AssetId kNotFound = UINT32_MAX;
+
+  SharedBookReader() = default;
+  SharedBookReader(const SharedBookReader &) = delete;
+  SharedBookReader &operator=(const SharedBookReader &) = delete;
+  ~SharedBookReader();
+
+  // Maps the region a SharedBookWriter created under `name`.
+  bool Open(const std::string &name);
+  std::size_t Assets() const { return asset_count; }
+  // Id of the asset named `name`, or kNotFound.
+  AssetId Find(const std::string &name) const;
+
+  // Changes whenever the asset's quote is republished; polling this is one
+  // load from a line the writer only touches on a publish.
+  std::uint64_t QuoteVersion(AssetId asset) const {
+    return assets[asset].quote.sequence.load(std::memory_order_acquire);
+  }
+  // Consistent copies, retried until no publish overlapped them.
+  BookQuote ReadQuote(AssetId asset) const;
+  void ReadDepth(AssetId asset, BookDepth &depth) const;
+
+private:
+  const void *region = nullptr;
+  std::size_t size = 0;
+  const sharedbook::Asset *assets = nullptr;
+  std::size_t asset_count = 0;
+};
@@ -0,0 +1,142 @@
+#include "snapshot.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+std::uint64_t Align8(std::uint64_t offset) { return (offset + 7) & ~7ull; }
+
+long MinorFaults() {
+  struct rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+std::uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+} // namespace
+
+SnapshotLayout::SnapshotLayout(const SnapshotHeader &h) {
+  name_ends = Align8(sizeof(SnapshotHeader));
+  names = name_ends + (h.user_count + h.asset_count) * sizeof(std::uint64_t);
+  assets = Align8(names + h.name_bytes);
+  open_accounts = assets + h.asset_count * sizeof(SnapshotAsset);
+  balances = Align8(open_accounts + h.ledger_rows);
+  orders =
+      balances + h.ledger_rows * h.ledger_stride * sizeof(std::int64_t);
+  fill_lists = orders + h.order_count * sizeof(SnapshotOrder);
+  fills = fill_lists + h.user_count * sizeof(SnapshotFillList);
+  trades = fills + h.fill_count * sizeof(FillRecord);
+  end = trades + h.trade_count * sizeof(Trade);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+  if (file) {
+    std::fclose(file);
+    std::remove(temp_path.c_str());
+  }
+}
+
+bool SnapshotWriter::Open(const std::string &target) {
+  path = target;
+  temp_path = target + ".tmp";
+  file = std::fopen(temp_path.c_str(), "wb");
+  if (file) std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+  return file;
+}
+
+void SnapshotWriter::Write(const void *data, std::size_t size) {
+  std::fwrite(data, 1, size, file);
+  offset += size;
+}
+
+void SnapshotWriter::Pad() {
+  static const char zeros[8] = {};
+  Write(zeros, Align8(offset) - offset);
+}
+
+bool SnapshotWriter::Commit() {
+  bool ok = std::fflush(file) == 0 && !std::ferror(file) &&
+            ::fsync(::fileno(file)) == 0;
+  ok &= std::fclose(file) == 0;
+  file = nullptr;
+  ok = ok && std::rename(temp_path.c_str(), path.c_str()) == 0;
+  if (!ok) std::remove(temp_path.c_str());
+  return ok;
+}
+
+MappedFile::~MappedFile() {
+  if (data) ::munmap(const_cast<char *>(data), size);
+}
+
+bool MappedFile::Open(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) return false;
+  // Restores read the file front to back once.
+  ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+  data = static_cast<const char *>(p);
+  size = st.st_size;
+  return true;
+}
+
+void SnapshotMetrics::Print(std::ostream &os) const {
+  os << "Background Snapshots: " << started << " started, " << written
+     << " written, " << failed << " failed" << std::endl;
+  os << "  fork stall (ns): p50 " << fork_stall.Percentile(0.5) << ", max "
+     << fork_stall.Max() << std::endl;
+  os << "  last duration (ms): " << last_duration_ns / 1000000 << std::endl;
+  os << "  page faults while running: " << page_faults << std::endl;
+}
+
+BackgroundSnapshot::~BackgroundSnapshot() { Poll(true); }
+
+bool BackgroundSnapshot::Start(const std::function<bool()> &write) {
+  if (Poll()) return false;
+  faults_at_start = MinorFaults();
+  start = std::chrono::steady_clock::now();
+  const pid_t pid = ::fork();
+  if (pid == 0) {
+    // Skip atexit handlers and stdio buffers inherited from the parent.
+    ::_exit(write() ? 0 : 1);
+  }
+  metrics.fork_stall.Record(NanosecondsSince(start));
+  if (pid < 0) {
+    ++metrics.failed;
+    return false;
+  }
+  child = pid;
+  ++metrics.started;
+  return true;
+}
+
+bool BackgroundSnapshot::Poll(bool wait) {
+  if (child <= 0) return false;
+  int status;
+  pid_t pid;
+  do {
+    pid = ::waitpid(child, &status, wait ? 0 : WNOHANG);
+  } while (pid < 0 && errno == EINTR);
+  if (pid == 0) return true;
+  const bool ok = pid == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (ok) ++metrics.written;
+  else ++metrics.failed;
+  metrics.last_duration_ns = NanosecondsSince(start);
+  metrics.page_faults += MinorFaults() - faults_at_start;
+  child = -1;
+  return false;
+}
@@ -0,0 +1,177 @@
+#pragma once
+// Binary snapshots of exchange state. A snapshot is a header followed by
+// flat arrays of fixed-size records, each section starting on an 8-byte
+// boundary, so a restore maps the file and reads records in place instead
+// of parsing it field by field.
+//
+// File layout (native byte order), sections in this order:
+//   SnapshotHeader
+//   u64 name_ends[user_count + asset_count] - end of each name in the blob;
+//                                             users by id, then assets by id
+//   char names[name_bytes]
+//   SnapshotAsset assets[asset_count]
+//   u8 open_accounts[ledger_rows]            - 1 if the row is an account
+//   i64 balances[ledger_rows * ledger_stride]
+//   SnapshotOrder orders[order_count]        - resting orders by id
+//   SnapshotFillList fill_lists[user_count]
+//   FillRecord fills[fill_count]
+//   Trade trades[trade_count]
+//
+// BackgroundSnapshot writes one from a forked child instead: the child sees
+// a copy-on-write image of the process frozen at the fork, so the caller
+// only stalls for the fork itself and then for the pages it writes to while
+// the child runs, which the kernel copies on first touch.
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <sys/types.h>
+
+#include "latency.hpp"
+#include "orderbook.hpp"
+#include "utility.hpp"
+
+struct SnapshotHeader {
+  static constexpr std::uint32_t kMagic = 0x314E5358; // "XSN1"
+  static constexpr std::uint32_t kVersion = 1;
+
+  std::uint32_t magic = kMagic;
+  std::uint32_t version = kVersion;
+  std::int64_t quote_scale = 0;
+  std::uint64_t journal_sequence = 0;
+  std::uint64_t next_order_id = 0;
+  std::uint64_t user_count = 0;
+  std::uint64_t asset_count = 0;
+  std::uint64_t name_bytes = 0;
+  std::uint64_t ledger_rows = 0;
+  std::uint64_t ledger_stride = 0;
+  std::uint64_t order_count = 0;
+  std::uint64_t fill_count = 0;
+  std::uint64_t trade_count = 0;
+};
+
+// Listing terms of one asset; its symbol is in the name blob and its quote
+// is always USD.
+struct SnapshotAsset {
+  std::int64_t qty_decimals;
+  std::int64_t lot_size;
+  std::int64_t tick_size;
+  std::int64_t min_price;
+  std::int64_t max_price;
+};
+
+struct SnapshotOrder {
+  OrderId id;
+  BookOrder order;
+};
+
+struct SnapshotFillList {
+  std::uint32_t head;
+  std::uint32_t tail;
+  std::uint32_t count;
+  std::uint32_t unused;
+};
+
+// Byte offset of each section of a snapshot with the counts in `header`.
+struct SnapshotLayout {
+  explicit SnapshotLayout(const SnapshotHeader &header);
+
+  std::uint64_t name_ends;
+  std::uint64_t names;
+  std::uint64_t assets;
+  std::uint64_t open_accounts;
+  std::uint64_t balances;
+  std::uint64_t orders;
+  std::uint64_t fill_lists;
+  std::uint64_t fills;
+  std::uint64_t trades;
+  std::uint64_t end; // file size
+};
+
+// Writes a snapshot to a temporary file next to `path` and renames it into
+// place on Commit(), so a crash never leaves a partial snapshot at `path`.
+class SnapshotWriter {
+public:
+  SnapshotWriter() = default;
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+  // Removes the temporary file unless committed.
+  ~SnapshotWriter();
+
+  bool Open(const std::string &path);
+  void Write(const void *data, std::size_t size);
+  template <typename T> void Write(const T &value) {
+    Write(&value, sizeof(value));
+  }
+  // Zero-fills to the next 8-byte boundary.
+  void Pad();
+  // Flushes, fsyncs and renames the file into place.
+  bool Commit();
+
+private:
+  std::string path;
+  std::string temp_path;
+  std::FILE *file = nullptr;
+  std::uint64_t offset = 0;
+};
+
+// A whole file mapped read-only.
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  bool Open(const std::string &path);
+  const char *Data() const { return data; }
+  std::size_t Size() const { return size; }
+
+private:
+  const char *data = nullptr;
+  std::size_t size = 0;
+};
+
+// What background snapshots have cost the thread that starts them.
+struct SnapshotMetrics {
+  std::uint64_t started = 0;
+  std::uint64_t written = 0;
+  std::uint64_t failed = 0;
+  LatencyHistogram fork_stall;        // time spent in fork()
+  std::uint64_t last_duration_ns = 0; // fork to the child's exit
+  // Minor page faults this process took while children ran; mostly
+  // copy-on-write copies of pages the engine touched.
+  std::uint64_t page_faults = 0;
+
+  void Print(std::ostream &os) const;
+};
+
+// Runs one snapshot at a time in a forked child. The child must not use
+// locks another thread of the parent may have held at the fork: a journal
+// writer, for one, is not safe to touch there.
+class BackgroundSnapshot {
+public:
+  BackgroundSnapshot() = default;
+  BackgroundSnapshot(const BackgroundSnapshot &) = delete;
+  BackgroundSnapshot &operator=(const BackgroundSnapshot &) = delete;
+  // Waits for a running child.
+  ~BackgroundSnapshot();
+
+  // Forks a child that calls `write` and exits with its result. Returns
+  // false if a snapshot is already running or the fork fails.
+  bool Start(const std::function<bool()> &write);
+  bool Running() const { return child > 0; }
+  // Reaps the child once it has exited, blocking for it with `wait`.
+  // Returns whether a snapshot is still running.
+  bool Poll(bool wait = false);
+  const SnapshotMetrics &Metrics() const { return metrics; }
+
+private:
+  pid_t child = -1;
+  std::chrono::steady_clock::time_point start;
+  long faults_at_start = 0;
+  SnapshotMetrics metrics;
+};
@@ -0,0 +1,30 @@
+#include "symboltable.hpp"
+#include <algorithm>
+#include <numeric>
+
+std::uint32_t SymbolTable::Intern(std::string_view name) {
+  const std::uint32_t id = Find(name);
+  if (id != kNotFound) return id;
+  names.emplace_back(name);
+  ids.emplace(names.back(), names.size() - 1);
+  return names.size() - 1;
+}
+
+void SymbolTable::Reserve(std::size_t count) {
+  ids.reserve(count);
+}
+
+std::uint32_t SymbolTable::Find(std::string_view name) const {
+  auto it = ids.find(name);
+  return (it == ids.end()) ? kNotFound : it->second;
+}
+
+std::vector<std::uint32_t> SymbolTable::SortedIds() const {
+  std::vector<std::uint32_t> sorted(names.size());
+  std::iota(sorted.begin(), sorted.end(), 0);
+  std::sort(sorted.begin(), sorted.end(),
+            [this](std::uint32_t a, std::uint32_t b) {
+              return names[a] < names[b];
+            });
+  return sorted;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Maps names to dense ids (0, 1, 2, ... in first-seen order) and back, so the
+// engine can index by id instead of comparing strings. Lookups take any
+// string_view and allocate nothing; the keys view the stored names, which
+// never move, so a table cannot be copied.
+class SymbolTable {
+public:
+  static constexpr std::uint32_t kNotFound = UINT32_MAX;
+
+  SymbolTable() = default;
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+
+  std::uint32_t Intern(std::string_view name);
+  // Id of `name`, or kNotFound if it has never been interned.
+  std::uint32_t Find(std::string_view name) const;
+  const std::string &Name(std::uint32_t id) const { return names[id]; }
+  std::uint32_t Size() const { return names.size(); }
+  void Reserve(std::size_t count);
+  // All ids, ordered by name.
+  std::vector<std::uint32_t> SortedIds() const;
+
+private:
+  std::unordered_map<std::string_view, std::uint32_t> ids;
+  std::deque<std::string> names;
+};
@@ -1 +1,31 @@
-#include "useraccount.hpp"
\ No newline at end of file
+#include "useraccount.hpp"
+#include <algorithm>
+
+void Ledger::OpenAccount(UserId user) {
+  if (user >= accounts.size()) {
+    accounts.resize(user + 1);
+    balances.resize(accounts.size() * stride);
+  }
+  accounts[user] = true;
+}
+
+void Ledger::AddAsset(AssetId asset) {
+  if (asset < stride) return;
+  AssetId new_stride = std::max<AssetId>(stride, 4);
+  while (new_stride <= asset) new_stride *= 2;
+
+  std::vector<std::int64_t> restrided(accounts.size() * new_stride);
+  for (std::size_t user = 0; user < accounts.size(); ++user) {
+    std::copy_n(balances.begin() + user * stride, stride,
+                restrided.begin() + user * new_stride);
+  }
+  balances.swap(restrided);
+  stride = new_stride;
+}
+
+void Ledger::Load(AssetId new_stride, std::size_t rows,
+                  const std::uint8_t *open, const std::int64_t *data) {
+  stride = new_stride;
+  accounts.assign(open, open + rows);
+  balances.assign(data, data + rows * stride);
+}
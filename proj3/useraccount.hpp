@@ -1 +1,68 @@
-#pragma once
\ No newline at end of file
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utility.hpp"
+
+// Balances of every account, kept in one flat array with a row of `stride`
+// balances per user, so a credit or debit is a single indexed access. Rows
+// and columns are only added when a user or asset is first seen, never while
+// settling a fill. Amounts are raw units of the asset: Qty units for listed
+// assets and Notional units for USD.
+class Ledger {
+public:
+  void OpenAccount(UserId user);
+  // Makes room for `asset` in every row.
+  void AddAsset(AssetId asset);
+
+  bool HasAccount(UserId user) const {
+    return user < accounts.size() && accounts[user];
+  }
+
+  std::int64_t Balance(UserId user, AssetId asset) const {
+    return (HasAccount(user) && asset < stride) ? balances[Index(user, asset)]
+                                                : 0;
+  }
+
+  // The account must be open and the asset added.
+  void Credit(UserId user, AssetId asset, std::int64_t amount) {
+    balances[Index(user, asset)] += amount;
+  }
+
+  bool CanDebit(UserId user, AssetId asset, std::int64_t amount) const {
+    return HasAccount(user) && asset < stride &&
+           (balances[Index(user, asset)] - amount) >= 0;
+  }
+
+  bool Debit(UserId user, AssetId asset, std::int64_t amount) {
+    if (!CanDebit(user, asset, amount)) return false;
+    balances[Index(user, asset)] -= amount;
+    return true;
+  }
+
+  // Starts loading a balance into cache ahead of its use.
+  void Prefetch(UserId user, AssetId asset) const {
+    if (HasAccount(user) && asset < stride) {
+      __builtin_prefetch(&balances[Index(user, asset)]);
+    }
+  }
+
+  // Raw storage, for snapshots: Rows() rows of Stride() balances, of which
+  // only those with HasAccount() are accounts.
+  AssetId Stride() const { return stride; }
+  std::size_t Rows() const { return accounts.size(); }
+  const std::vector<std::int64_t> &Balances() const { return balances; }
+  // Replaces all storage. `open[row]` is nonzero for rows that are accounts.
+  void Load(AssetId stride, std::size_t rows, const std::uint8_t *open,
+            const std::int64_t *balances);
+
+private:
+  std::size_t Index(UserId user, AssetId asset) const {
+    return static_cast<std::size_t>(user) * stride + asset;
+  }
+
+  std::vector<std::int64_t> balances;
+  std::vector<bool> accounts;
+  AssetId stride = 0;
+};
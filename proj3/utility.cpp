@@ -1,5 +1,11 @@
 #include "utility.hpp"
 
+Side ParseSide(const std::string &side) {
+  return (side == "Sell") ? Side::Sell : Side::Buy;
+}
+
+const char *SideName(Side side) { return (side == Side::Sell) ? "Sell" : "Buy"; }
+
 bool Order::operator==(const Order &o) const {
   return (username == o.username) && (side == o.side) && (asset == o.asset) &&
          (amount == o.amount) && (price == o.price);
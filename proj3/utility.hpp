@@ -1,20 +1,38 @@
 #pragma once
+#include <cstdint>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#include "fixedpoint.hpp"
+
+// Exchange-assigned order identifier. IDs increase monotonically from 1; 0 is
+// returned for rejected orders.
+using OrderId = std::uint64_t;
+constexpr OrderId kInvalidOrderId = 0;
+
+// Interned user and asset names (see SymbolTable).
+using UserId = std::uint32_t;
+using AssetId = std::uint32_t;
+
+enum class Side : std::uint8_t { Buy, Sell };
+
+// "Sell" is a sell; anything else is treated as a buy.
+Side ParseSide(const std::string &side);
+const char *SideName(Side side);
+
 class Order {
 public:
   std::string username;
   std::string side; // Can be "Buy" or "Sell"
   std::string asset;
-  int amount;
-  int price;
+  Qty amount;  // in the asset's quantity units
+  Price price; // in the asset's price units
 
   // Constructors
   // 5-Arg constructor
-  Order(const std::string &u, const std::string &s, const std::string &a, int q,
-        int p)
+  Order(const std::string &u, const std::string &s, const std::string &a, Qty q,
+        Price p)
       : username(u), side(s), asset(a), amount(q), price(p) {}
 
   // copy constructor
@@ -29,10 +47,20 @@ public:
   friend std::ostream &operator<<(std::ostream &os, const Order &o);
 };
 
+// Order as the engine stores it: fixed-size, with interned ids in place of
+// the strings carried by Order.
+struct BookOrder {
+  UserId user;
+  Side side;
+  AssetId asset;
+  Qty amount;
+  Price price;
+};
+
 struct Trade {
-  std::string buyer_username;
-  std::string seller_username;
-  std::string asset;
-  int amount;
-  int price;
+  UserId buyer;
+  UserId seller;
+  AssetId asset;
+  Qty amount;
+  Price price;
 };